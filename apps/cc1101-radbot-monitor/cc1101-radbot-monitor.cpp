@@ -114,11 +114,11 @@ int main()
     auto cc1101_ui = std::make_shared<CC1101UI>(cc1101);
     auto cc1101_ui_raw = make_cc1101_raw_ui(cc1101);
 
-    std::vector<GPIOWatcher<CC1101>*> gpio_watchers;
-    gpio_watchers.push_back(new GPIOWatcher<CC1101>("/dev/gpiochip0", 25, "WLMCD-CC1101", cc1101, true,
-      [&radbot_decoder](int, unsigned, const timespec*, std::shared_ptr<CC1101> cc1101) {
-        return CC1101_fRX(cc1101, radbot_decoder);
-      }));
+    std::weak_ptr<CC1101> wcc1101 = cc1101;
+    cc1101->EnableInterrupts("/dev/gpiochip0", -1, 25, [wcc1101, &radbot_decoder]() {
+      if (auto cc1101 = wcc1101.lock())
+        CC1101_fRX(cc1101, radbot_decoder);
+    });
 
     shell->controller->AddSystem(cc1101_ui);
     shell->controller->AddSystem(cc1101_ui_raw);
@@ -150,10 +150,11 @@ int main()
 
     std::vector<GPIOWatcher<Radio>*> gpio_watchers;
 #ifdef USE_C1101
-    gpio_watchers.push_back(new GPIOWatcher<Radio>("/dev/gpiochip0", 25, "WLMCD-CC1101", radio, true,
-      [](int, unsigned, const timespec*, std::shared_ptr<Radio> radio) {
-        return fRX(radio);
-      }));
+    std::weak_ptr<Radio> wradio = radio;
+    radio->EnableInterrupts("/dev/gpiochip0", -1, 25, [wradio]() {
+      if (auto radio = wradio.lock())
+        fRX(radio);
+    });
 #else
     gpio_watchers.push_back(new GPIOWatcher<Radio>("/dev/gpiochip0", 25, "WLMCD-SPIRIT1", radio, false,
       [](int, unsigned, const timespec*, std::shared_ptr<Radio> radio) {
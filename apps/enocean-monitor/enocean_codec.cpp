@@ -1,21 +1,58 @@
 // Copyright (c) Christoph M. Wintersteiger
 // Licensed under the MIT License.
 
+#include <bitstream.h>
+
 #include "enocean_codec.h"
 
 namespace EnOcean
 {
-  static size_t find_sof(const std::vector<uint8_t> &bytes, size_t from)
+  // Each data byte goes over the air inverted, as a 12-bit group: 3 bits, a
+  // stuffing bit (the complement of the previous one), 3 bits, another
+  // stuffing bit, 2 bits, and a 2-bit sync (01: last byte, 10: more to come).
+  struct Tables {
+    int16_t group[4096]; // data byte | 0x100 if last, -1 if invalid
+    uint16_t code[256];  // group for a data byte, without the sync bits
+
+    constexpr Tables() : group(), code()
+    {
+      for (unsigned g = 0; g < 4096; g++) {
+        auto bit = [g](unsigned i) { return (g >> (11 - i)) & 0x01; };
+        uint8_t syn = (bit(10) << 1) | bit(11);
+        if (bit(2) + bit(3) != 1 || bit(6) + bit(7) != 1 || (syn != 0x01 && syn != 0x02))
+          group[g] = -1;
+        else {
+          uint8_t b = bit(0) << 7 | bit(1) << 6 | bit(2) << 5 | bit(4) << 4 |
+                      bit(5) << 3 | bit(6) << 2 | bit(8) << 1 | bit(9) << 0;
+          group[g] = (uint8_t)~b | (syn == 0x01 ? 0x100 : 0x000);
+        }
+      }
+      for (unsigned x = 0; x < 256; x++) {
+        uint8_t d = ~x;
+        uint16_t nb3 = (d & 0x20) != 0 ? 0x00 : 0x01;
+        uint16_t nb6 = (d & 0x04) != 0 ? 0x00 : 0x01;
+        uint16_t top3 = (d & 0xE0) >> 5;
+        uint16_t mid3 = (d & 0x1C) >> 2;
+        uint16_t last2 = d & 0x3;
+        code[x] = (top3 << 9) | (nb3 << 8) | (mid3 << 5) | (nb6 << 4) | (last2 << 2);
+      }
+    }
+  };
+
+  static constexpr Tables tables;
+
+  // Finds the next 0110 start-of-frame sequence, 54 candidate positions at a time.
+  static size_t find_sof(BitReader &br)
   {
-    size_t end = bytes.size() * 8;
-    for (size_t i = from; i < end; i++) {
-      if (get_bit(bytes, i+0) == 0 &&
-          get_bit(bytes, i+1) == 1 &&
-          get_bit(bytes, i+2) == 1 &&
-          get_bit(bytes, i+3) == 0)
-      {
-        return i;
+    size_t end = br.End();
+    while (br.Position() + 4 <= end) {
+      uint64_t w = br.Peek(57);
+      uint64_t m = ~(w >> 3) & (w >> 2) & (w >> 1) & ~w & ((1ull << 54) - 1);
+      if (m != 0) {
+        size_t i = br.Position() + 53 - (63 - __builtin_clzll(m));
+        return i + 4 <= end ? i : end;
       }
+      br.Skip(54);
     }
     return end;
   }
@@ -40,31 +77,22 @@ namespace EnOcean
   {
     std::vector<std::shared_ptr<Frame>> frames;
 
-    const size_t end = bytes.size() * 8;
+    BitReader br(bytes);
+    const size_t end = br.End();
     size_t sof = 0;
-    while ((sof = find_sof(bytes, sof)) < end) {
-      size_t pos = sof + 4;
+    while ((sof = find_sof(br)) < end) {
+      br.Seek(sof + 4);
       std::vector<uint8_t> fbytes;
 
-      while (end - pos > 12) {
-        uint8_t b[12];
-        for (size_t i=0; i < 12; i++)
-          b[i] = get_bit(bytes, pos + i);
-
-        if (b[2] + b[3] != 1 || b[6] + b[7] != 1)
-          break;
-
-        uint8_t syn = (b[10] << 1) | b[11];
-        if (syn != 0x01 && syn != 0x02)
+      while (br.Remaining() > 12) {
+        int16_t g = tables.group[br.Peek(12)];
+        if (g < 0)
           break;
 
-        fbytes.push_back(b[0] << 7 | b[1] << 6 | b[2] << 5 | b[4] << 4 |
-                         b[5] << 3 | b[6] << 2 | b[8] << 1 | b[9] << 0);
-        fbytes.back() = ~fbytes.back();
+        fbytes.push_back(g & 0xFF);
+        br.Skip(12);
 
-        pos += 12;
-
-        if (syn == 0x01)
+        if (g & 0x100)
           break;
       }
 
@@ -73,7 +101,7 @@ namespace EnOcean
       }
       catch (...) {}
 
-      sof = pos + 1;
+      br.Seek(br.Position() + 1);
     }
 
     return frames;
@@ -89,27 +117,15 @@ namespace EnOcean
   {
     std::vector<uint8_t> r;
     r.reserve(data.size() * 2);
-    r.push_back(0x55); // preamble
-    uint16_t rem = 0x06; // 4-bit sync sequence
+    BitWriter bw(r);
+    bw.Write(0x55, 8); // preamble
+    bw.Write(0x06, 4); // 4-bit sync sequence
     for (size_t i=0; i < data.size(); i++) {
-      uint8_t d = ~data[i];
-      uint16_t nb3 = (d & 0x20) != 0 ? 0x00 : 0x01;
-      uint16_t nb6 = (d & 0x04) != 0 ? 0x00 : 0x01;
-      uint16_t top3 = (d & 0xE0) >> 5;
-      uint16_t mid3 = (d & 0x1C) >> 2;
-      uint16_t last2 = d & 0x3;
       uint16_t next = i == data.size() - 1 ? 0x01 : 0x02;
-      uint16_t e = (top3 << 9) | (nb3 << 8) | (mid3 << 5) | (nb6 << 4) | (last2 << 2) | next;
-      if (i % 2 != 0) {
-        r.push_back(e >> 4);
-        rem = e & 0x000F;
-      } else {
-        r.push_back((rem << 4) | e >> 8);
-        r.push_back(e & 0x00FF);
-        rem = 0;
-      }
+      bw.Write(tables.code[data[i]] | next, 12);
     }
-    r.push_back(rem << 4);
+    bw.Write(0x00, 4);
+    bw.Flush();
     return r;
   }
 
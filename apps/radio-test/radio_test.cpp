@@ -162,6 +162,11 @@ int main(int argc, const char **argv)
 
     if (radio_name == "cc1101") {
       auto cc1101 = std::make_shared<CC1101>(0, 0, "cc1101.cfg");
+      std::weak_ptr<Radio> wradio = cc1101;
+      cc1101->EnableInterrupts("/dev/gpiochip0", -1, 25, [wradio]() {
+        if (auto radio = wradio.lock())
+          fRX(radio);
+      });
       radio = std::static_pointer_cast<Radio>(cc1101);
       radio_ui = std::make_shared<CC1101UI>(cc1101);
       radio_ui_raw = make_cc1101_raw_ui(cc1101);
@@ -183,13 +188,7 @@ int main(int argc, const char **argv)
     auto radio_test_ui = std::make_shared<RadioTestUI>(radio_devs, radio_test_tracker);
 
     std::vector<GPIOWatcher<Radio>*> gpio_watchers;
-    if (radio_name == "cc1101") {
-      gpio_watchers.push_back(new GPIOWatcher<Radio>("/dev/gpiochip0", 25, "WLMCD-CC1101", radio, true,
-        [](int, unsigned, const timespec*, std::shared_ptr<Radio> radio) {
-          return fRX(radio);
-        }));
-    }
-    else {
+    if (radio_name != "cc1101") {
       gpio_watchers.push_back(new GPIOWatcher<Radio>("/dev/gpiochip0", 25, "WLMCD-SPIRIT1", radio, false,
         [](int, unsigned, const timespec*, std::shared_ptr<Radio> radio) {
           return fIRQ(radio);
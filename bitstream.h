@@ -0,0 +1,161 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _BITSTREAM_H_
+#define _BITSTREAM_H_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+inline uint64_t reverse_bits(uint64_t x, unsigned n)
+{
+  x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+  x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+  x = __builtin_bswap64(x);
+  return n == 0 ? 0 : x >> (64 - n);
+}
+
+// MSB-first bit cursor over a byte buffer. Up to 64 upcoming bits are kept in
+// a register, so peeks and reads of up to 57 bits are a shift and a mask.
+// Bits past the end of the buffer read as 0; see Remaining().
+class BitReader {
+public:
+  BitReader(const uint8_t *data, size_t size, size_t pos = 0) :
+    data(data), size(size), pos(pos), cache(0), cached(0) {}
+  BitReader(const std::vector<uint8_t> &buf, size_t pos = 0) :
+    BitReader(buf.data(), buf.size(), pos) {}
+
+  size_t Position() const { return pos; }
+  size_t End() const { return size * 8; }
+  size_t Remaining() const { return pos < End() ? End() - pos : 0; }
+
+  void Seek(size_t bit_pos)
+  {
+    pos = bit_pos;
+    cache = 0;
+    cached = 0;
+  }
+
+  // The next n <= 57 bits, without consuming them.
+  uint64_t Peek(unsigned n)
+  {
+    if (cached < n)
+      Refill();
+    return n == 0 ? 0 : cache >> (64 - n);
+  }
+
+  void Skip(size_t n)
+  {
+    if (n < cached) {
+      cache <<= n;
+      cached -= n;
+      pos += n;
+    }
+    else
+      Seek(pos + n);
+  }
+
+  uint64_t Read(unsigned n)
+  {
+    uint64_t r = Peek(n);
+    Skip(n);
+    return r;
+  }
+
+  bool ReadBit() { return Read(1) != 0; }
+
+  // Like Read, but the first bit ends up in the LSB.
+  uint64_t ReadReversed(unsigned n) { return reverse_bits(Read(n), n); }
+
+  // Copies n bytes; a plain memcpy when the cursor is byte-aligned.
+  void ReadBytes(uint8_t *out, size_t n)
+  {
+    if (pos % 8 == 0 && pos / 8 + n <= size) {
+      memcpy(out, data + pos / 8, n);
+      Seek(pos + 8 * n);
+    }
+    else
+      for (size_t i = 0; i < n; i++)
+        out[i] = Read(8);
+  }
+
+protected:
+  const uint8_t *data;
+  size_t size, pos;
+  uint64_t cache; // The `cached` bits from `pos` on, MSB-aligned.
+  unsigned cached;
+
+  uint8_t Byte(size_t i) const { return i < size ? data[i] : 0; }
+
+  void Refill()
+  {
+    if (cached == 0 && pos % 8 != 0) {
+      unsigned o = pos % 8;
+      cache = (uint64_t)(uint8_t)(Byte(pos / 8) << o) << 56;
+      cached = 8 - o;
+    }
+    while (cached <= 56) {
+      cache |= (uint64_t)Byte((pos + cached) / 8) << (56 - cached);
+      cached += 8;
+    }
+  }
+};
+
+// MSB-first bit writer that appends to a byte vector. A partial last byte is
+// padded with zeros by Flush (or on destruction).
+class BitWriter {
+public:
+  BitWriter(std::vector<uint8_t> &buf) : buf(buf), start(buf.size() * 8), acc(0), pending(0) {}
+  virtual ~BitWriter() { Flush(); }
+
+  // Bits written so far.
+  size_t Position() const { return buf.size() * 8 + pending - start; }
+
+  // Appends the n <= 57 low bits of val, MSB first.
+  void Write(uint64_t val, unsigned n)
+  {
+    if (n == 0)
+      return;
+    acc |= (val << (64 - n)) >> pending;
+    pending += n;
+    while (pending >= 8) {
+      buf.push_back(acc >> 56);
+      acc <<= 8;
+      pending -= 8;
+    }
+  }
+
+  void WriteBit(bool val) { Write(val ? 1 : 0, 1); }
+
+  // Appends the n low bits of val, LSB first.
+  void WriteReversed(uint64_t val, unsigned n) { Write(reverse_bits(val, n), n); }
+
+  // Appends n bytes; a plain insert when the stream is byte-aligned.
+  void WriteBytes(const uint8_t *data, size_t n)
+  {
+    if (pending == 0)
+      buf.insert(buf.end(), data, data + n);
+    else
+      for (size_t i = 0; i < n; i++)
+        Write(data[i], 8);
+  }
+
+  void Flush()
+  {
+    if (pending > 0) {
+      buf.push_back(acc >> 56);
+      acc = 0;
+      pending = 0;
+    }
+  }
+
+protected:
+  std::vector<uint8_t> &buf;
+  size_t start;
+  uint64_t acc; // `pending` bits not yet in buf, MSB-aligned.
+  unsigned pending;
+};
+
+#endif // _BITSTREAM_H_
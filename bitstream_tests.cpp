@@ -0,0 +1,148 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bitstream.h"
+#include "bitstream_tests.h"
+
+// Bit i of buf, MSB first; 0 past the end.
+static unsigned bit_ref(const std::vector<uint8_t> &buf, size_t i)
+{
+  return i / 8 < buf.size() ? (buf[i / 8] >> (7 - i % 8)) & 0x01 : 0;
+}
+
+static uint64_t bits_ref(const std::vector<uint8_t> &buf, size_t pos, unsigned n)
+{
+  uint64_t r = 0;
+  for (unsigned i = 0; i < n; i++)
+    r = (r << 1) | bit_ref(buf, pos + i);
+  return r;
+}
+
+#define CHECK(C, ...) { if (!(C)) { printf("Failed: "); printf(__VA_ARGS__); printf("\n"); r = 1; } }
+
+int bitstream_tests(int argc, const char **argv)
+{
+  int r = 0;
+  std::mt19937_64 rng(42);
+
+  CHECK(reverse_bits(0x1, 1) == 0x1 && reverse_bits(0x6, 3) == 0x3 &&
+        reverse_bits(0x0123456789ABCDEFull, 64) == 0xF7B3D591E6A2C480ull, "reverse_bits");
+
+  // Fixed vectors: unaligned peeks across the first refill, and reads past the end.
+  {
+    std::vector<uint8_t> buf = { 0xA5, 0x3C, 0xFF, 0x00, 0x81 };
+    BitReader br(buf, 3);
+    CHECK(br.Peek(5) == 0x05 && br.Position() == 3, "unaligned peek");
+    br.Skip(7);
+    CHECK(br.Position() == 10 && br.Read(12) == 0xF3F, "skip across bytes");
+    CHECK(br.Remaining() == 18 && br.Read(18) == 0x30081, "read to the end");
+    CHECK(br.Remaining() == 0 && br.Read(57) == 0, "read past the end");
+    BitReader br2(buf);
+    CHECK(br2.ReadReversed(8) == 0xA5 && br2.ReadReversed(4) == 0xC, "reversed reads");
+  }
+
+  for (size_t t = 0; t < 2000; t++) {
+    std::vector<uint8_t> buf(rng() % 40 + 1);
+    for (auto &b : buf)
+      b = rng();
+    const size_t end = buf.size() * 8;
+
+    // Random peeks, reads, skips (including long ones that drop the cache)
+    // and reversed reads from an unaligned start, running past the end.
+    size_t pos = rng() % end;
+    BitReader br(buf, pos);
+    while (pos < end + 64) {
+      unsigned n = rng() % 58;
+      switch (rng() % 5) {
+      case 0:
+        CHECK(br.Peek(n) == bits_ref(buf, pos, n), "peek %u at %zu", n, pos);
+        break;
+      case 1:
+        CHECK(br.Read(n) == bits_ref(buf, pos, n), "read %u at %zu", n, pos);
+        pos += n;
+        break;
+      case 2:
+        n = rng() % 100;
+        br.Skip(n);
+        pos += n;
+        break;
+      case 3:
+        CHECK(reverse_bits(br.ReadReversed(n), n) == bits_ref(buf, pos, n), "reversed read %u at %zu", n, pos);
+        pos += n;
+        break;
+      case 4: {
+        uint8_t out[8];
+        size_t k = rng() % 9;
+        br.ReadBytes(out, k);
+        for (size_t i = 0; i < k; i++)
+          CHECK(out[i] == bits_ref(buf, pos + 8 * i, 8), "bytes %zu at %zu", k, pos);
+        pos += 8 * k;
+        break;
+      }
+      }
+      CHECK(br.Position() == pos, "position %zu != %zu", br.Position(), pos);
+      CHECK(br.Remaining() == (pos < end ? end - pos : 0), "remaining at %zu", pos);
+    }
+
+    // Aligned ReadBytes is a plain copy.
+    {
+      BitReader ba(buf);
+      std::vector<uint8_t> out(buf.size());
+      ba.ReadBytes(out.data(), out.size());
+      CHECK(out == buf && ba.Remaining() == 0, "aligned ReadBytes");
+    }
+
+    // Writer/reader round trip, appending to existing data.
+    std::vector<uint8_t> out = { 0xEE };
+    std::vector<std::pair<uint64_t, unsigned>> items;
+    {
+      BitWriter bw(out);
+      size_t written = 0;
+      for (size_t k = 0; k < 20; k++) {
+        unsigned n = rng() % 58;
+        uint64_t v = n == 0 ? 0 : rng() & (~0ull >> (64 - n));
+        switch (rng() % 4) {
+        case 0:
+          bw.Write(v, n);
+          break;
+        case 1:
+          bw.WriteReversed(reverse_bits(v, n), n);
+          break;
+        case 2:
+          v = rng() & 1; n = 1;
+          bw.WriteBit(v);
+          break;
+        case 3: {
+          uint8_t bytes[3] = { (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng() };
+          bw.WriteBytes(bytes, 3);
+          v = bytes[0] << 16 | bytes[1] << 8 | bytes[2]; n = 24;
+          break;
+        }
+        }
+        items.push_back({v, n});
+        written += n;
+        CHECK(bw.Position() == written, "writer position");
+      }
+    } // Flushes.
+
+    BitReader rd(out);
+    CHECK(rd.Read(8) == 0xEE, "existing data");
+    size_t bits = 0;
+    for (auto &it : items) {
+      CHECK(rd.Read(it.second) == it.first, "round trip of %u bits", it.second);
+      bits += it.second;
+    }
+    CHECK(out.size() == 1 + (bits + 7) / 8, "writer padding");
+    CHECK(rd.Read(rd.Remaining()) == 0, "padding is zero");
+  }
+
+  std::cout << "bits  : " << (r == 0 ? "ok" : "failed") << std::endl;
+
+  return r;
+}
@@ -0,0 +1,9 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _BITSTREAM_TESTS_H_
+#define _BITSTREAM_TESTS_H_
+
+int bitstream_tests(int argc, const char **argv);
+
+#endif
@@ -144,15 +144,13 @@ void BME280::RegisterTable::Read(std::istream &is)
     std::string sval = e.value().get<std::string>();
 
     bool found = false;
-    for (const auto reg : registers) {
-      if (reg->Name() == e.key()) {
-        found = true;
-        if (!reg->Writeable())
-          continue;
+    auto reg = Find(e.key());
+    if (reg) {
+      found = true;
+      if (reg->Writeable()) {
         uint8_t val;
         sscanf(sval.c_str(), "%02hhx", &val);
         device.Write(*reg, val);
-        break;
       }
     }
     if (!found)
@@ -76,8 +76,7 @@ void BME680::UpdateTimed()
 
 void BME680::RegisterTable::Refresh(bool frequent)
 {
-  for (auto reg : registers)
-    buffer[reg->Address()] = device.Read(*reg);
+  RefreshBursts(BurstPlan());
 }
 
 void BME680::RegisterTable::Write(std::ostream &os) const
@@ -116,15 +115,13 @@ void BME680::RegisterTable::Read(std::istream &is)
     std::string sval = e.value().get<std::string>();
 
     bool found = false;
-    for (const auto reg : registers) {
-      if (reg->Name() == e.key()) {
-        found = true;
-        if (!reg->Writeable())
-          continue;
+    auto reg = Find(e.key());
+    if (reg) {
+      found = true;
+      if (reg->Writeable()) {
         uint8_t val;
         sscanf(sval.c_str(), "%02hhx", &val);
         device.Write(*reg, val);
-        break;
       }
     }
     if (!found)
@@ -30,8 +30,11 @@ CC1101::CC1101(
   SPIDev(spi_bus, spi_channel, 10000000),
   RT(new RegisterTable(*this)),
   f_xosc(f_xosc),
-  recv_buf(new uint8_t[1024]), recv_buf_sz(1024), recv_buf_begin(0), recv_buf_pos(0)
+  recv_buf(new uint8_t[1024]), recv_buf_sz(1024), recv_buf_begin(0), recv_buf_pos(0),
+  status(0x80),
+  rx_active(false), rx_remaining(0), rx_ready(false), rx_length(0), rx_fixed(false)
 {
+  RT->Initialize();
   Reset();
 
   Strobe(CommandStrobe::SFTX, 100);
@@ -51,6 +54,7 @@ CC1101::CC1101(
 
 CC1101::~CC1101()
 {
+  DisableInterrupts();
   Reset();
   StrobeFor(CC1101::CommandStrobe::SIDLE, CC1101::State::IDLE, 10);
 
@@ -153,9 +157,10 @@ double CC1101::rFrequency() const
 void CC1101::wFrequency(double f)
 {
   uint32_t vi = static_cast<uint32_t>(f / (F_XOSC() / pow(2, 16)));
-  Write(RT->_rFREQ2, (vi >> 16) & 0xFF);
-  Write(RT->_rFREQ1, (vi >> 8) & 0xFF);
-  Write(RT->_rFREQ0, vi & 0xFF);
+  RT->Stage(RT->_rFREQ2, (vi >> 16) & 0xFF);
+  RT->Stage(RT->_rFREQ1, (vi >> 8) & 0xFF);
+  RT->Stage(RT->_rFREQ0, vi & 0xFF);
+  RT->Flush();
 }
 
 double CC1101::rDataRate() const
@@ -172,8 +177,9 @@ void CC1101::wDatarate(double f)
   uint8_t drate_m = ((f * pow(2, 28)) / (f_xosc * pow(2, drate_e))) - 256;
   if (drate_m == 0)
     drate_e++;
-  Write(RT->_rMDMCFG3, drate_m);
-  Write(RT->_rMDMCFG4, RT->_vDRATE_E_3_0, drate_e);
+  RT->Stage(RT->_rMDMCFG4, RT->_vDRATE_E_3_0, drate_e);
+  RT->Stage(RT->_rMDMCFG3, drate_m);
+  RT->Flush();
 }
 
 double CC1101::rDeviation() const
@@ -233,15 +239,72 @@ double CC1101::rRXTimeout() const {
 CC1101::StatusByte CC1101::Strobe(CommandStrobe cs, size_t delay_us)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> buf;
-  buf.push_back(cs & 0xFF);
-  SPIDev::Transfer(buf);
+  uint8_t b = cs & 0xFF;
+  SPIDev::Transfer(&b, 1);
+  status = b;
   if (delay_us)
     sleep_us(delay_us);
-  return StatusByte(buf[0]);
+  return StatusByte(b);
+}
+
+CC1101::StatusByte CC1101::Strobe(CommandStrobe first, CommandStrobe second, size_t delay_us)
+{
+  if (delay_us > UINT16_MAX) {
+    Strobe(first, delay_us);
+    return Strobe(second, delay_us);
+  }
+
+  // Both strobes in one ioctl, with a chip-select cycle in between.
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t buf[2] = { (uint8_t)(first & 0xFF), (uint8_t)(second & 0xFF) };
+  SPIDev::Transaction(*this, 2)
+    .Add(&buf[0], 1, true, delay_us)
+    .Add(&buf[1], 1, false, delay_us)
+    .Submit();
+  status = buf[1];
+  return StatusByte(buf[1]);
 }
 
 CC1101::StatusByte CC1101::StrobeFor(CommandStrobe cs, State st, size_t delay_us)
+{
+  StatusByte::SState want;
+  switch (st) {
+    case State::IDLE: want = StatusByte::SState::IDLE; break;
+    case State::RX: want = StatusByte::SState::RX; break;
+    case State::TX: want = StatusByte::SState::TX; break;
+    case State::FSTXON: want = StatusByte::SState::FSTXON; break;
+    case State::RXFIFO_OVERFLOW: want = StatusByte::SState::RXFIFO_OVERFLOW; break;
+    case State::TXFIFO_UNDERFLOW: want = StatusByte::SState::TXFIFO_UNDERFLOW; break;
+    default: return StrobeForMARCSTATE(cs, st, delay_us);
+  }
+
+  // The status byte shifted out with a strobe is the state before it took
+  // effect, so follow up with SNOPs (or recovery strobes) until it shows
+  // a ready chip in the state we want.
+  StatusByte r = Strobe(cs, delay_us);
+  size_t cnt = 0;
+  responsive = true;
+  while (true) {
+    r = Strobe(CommandStrobe::SNOP);
+    if (r.CHIP_RDYn() && r.State() == want)
+      break;
+
+    if (++cnt > 50) {
+      responsive = false;
+      break;
+    }
+
+    if (r.State() == StatusByte::SState::RXFIFO_OVERFLOW && want != r.State())
+      Strobe(CommandStrobe::SFRX, cs, delay_us);
+    else if (r.State() == StatusByte::SState::TXFIFO_UNDERFLOW && want != r.State())
+      Strobe(CommandStrobe::SFTX, cs, delay_us);
+    else if (delay_us)
+      sleep_us(delay_us);
+  }
+  return r;
+}
+
+CC1101::StatusByte CC1101::StrobeForMARCSTATE(CommandStrobe cs, State st, size_t delay_us)
 {
   StatusByte r = Strobe(cs, delay_us);
 
@@ -251,14 +314,10 @@ CC1101::StatusByte CC1101::StrobeFor(CommandStrobe cs, State st, size_t delay_us
   do {
     nst = (State)(Read(RT->_rMARCSTATE) & 0x1F);
 
-    if (nst == State::RXFIFO_OVERFLOW) {
-      r = Strobe(CommandStrobe::SFRX, delay_us);
-      r = Strobe(cs, delay_us);
-    }
-    else if (nst == State::TXFIFO_UNDERFLOW) {
-      r = Strobe(CommandStrobe::SFTX, delay_us);
-      r = Strobe(cs, delay_us);
-    }
+    if (nst == State::RXFIFO_OVERFLOW)
+      r = Strobe(CommandStrobe::SFRX, cs, delay_us);
+    else if (nst == State::TXFIFO_UNDERFLOW)
+      r = Strobe(CommandStrobe::SFTX, cs, delay_us);
 
     if (delay_us)
       sleep_us(delay_us);
@@ -281,30 +340,36 @@ void CC1101::Reset()
 uint8_t CC1101::Read(const uint8_t &addr)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> res(2);
-  res[0] = 0x80 | (addr & 0x7F);
-  SPIDev::Transfer(res);
-  return res[1];
+  uint8_t b[2] = { (uint8_t)(0x80 | (addr & 0x7F)), 0 };
+  SPIDev::Transfer(b, 2);
+  status = b[0];
+  return b[1];
 }
 
 std::vector<uint8_t> CC1101::Read(const uint8_t &addr, size_t length)
 {
-  const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> res;
-  res.resize(length + 1);
-  res[0] = addr | (length == 1 ? 0x80 : 0xC0);
-  SPIDev::Transfer(res);
-  res.erase(res.begin());
+  std::vector<uint8_t> res(length);
+  Read(addr, res.data(), length);
   return res;
 }
 
+void CC1101::Read(const uint8_t &addr, uint8_t *out, size_t length)
+{
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t *b = Scratch(length + 1);
+  memset(b, 0, length + 1);
+  b[0] = addr | (length == 1 ? 0x80 : 0xC0);
+  SPIDev::Transfer(b, length + 1);
+  status = b[0];
+  memcpy(out, b + 1, length);
+}
+
 CC1101::StatusByte CC1101::WriteS(const uint8_t &addr, const uint8_t &value)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> b(2);
-  b[0] = addr;
-  b[1] = value;
-  SPIDev::Transfer(b);
+  uint8_t b[2] = { addr, value };
+  SPIDev::Transfer(b, 2);
+  status = b[0];
   return b[0];
 }
 
@@ -313,20 +378,30 @@ CC1101::StatusByte CC1101::WriteS(Register<uint8_t, uint8_t> &reg, const uint8_t
   return WriteS(reg.Address(), value);
 }
 
-CC1101::StatusByte CC1101::WriteS(const uint8_t &addr, const std::vector<uint8_t> &values)
+CC1101::StatusByte CC1101::WriteS(const uint8_t &addr, const uint8_t *values, size_t n)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  size_t n = values.size();
-  std::vector<uint8_t> b(n+1);
+  uint8_t *b = Scratch(n + 1);
   b[0] = addr | (n == 1 ? 0x00 : 0x40);
-  memcpy(&b[1], values.data(), n);
-  SPIDev::Transfer(b);
+  memcpy(&b[1], values, n);
+  SPIDev::Transfer(b, n + 1);
+  status = b[0];
   return b[0];
 }
 
+CC1101::StatusByte CC1101::WriteS(Register<uint8_t, uint8_t> &reg, const uint8_t *values, size_t n)
+{
+  return WriteS(reg.Address(), values, n);
+}
+
+CC1101::StatusByte CC1101::WriteS(const uint8_t &addr, const std::vector<uint8_t> &values)
+{
+  return WriteS(addr, values.data(), values.size());
+}
+
 CC1101::StatusByte CC1101::WriteS(Register<uint8_t, uint8_t> &reg, const std::vector<uint8_t> &values)
 {
-  return WriteS(reg.Address(), values);
+  return WriteS(reg.Address(), values.data(), values.size());
 }
 
 void CC1101::Setup(const std::vector<uint8_t> &config, const std::vector<uint8_t> &patable)
@@ -358,72 +433,105 @@ void CC1101::Goto(Radio::State state)
   }
 }
 
-void CC1101::Receive(std::vector<uint8_t> &packet)
+uint8_t CC1101::ReadFIFOBytes(const Register<uint8_t, uint8_t> &reg)
 {
-  uint8_t pktctrl0 = RT->PKTCTRL0();
-  uint8_t pktctrl1 = RT->PKTCTRL1();
-  bool variable = (pktctrl0 & 0x3) == 1;
-  size_t variable_remaining = (size_t)-1;
-  bool status_appended = (pktctrl1 & 0x04) != 0;
-  unsigned sleep_interval = 16 * (1e6 / rDataRate());
-  bool fixed = (pktctrl0 & 0x3) == 0;
-  size_t fixed_size = RT->PKTLEN() + (status_appended ? 2 : 0);
+  // RXBYTES/TXBYTES may be wrong while they change; read until two agree (errata).
+  uint8_t r = Read(reg), last;
+  do {
+    last = r;
+    r = Read(reg);
+  } while (r != last);
+  return r;
+}
 
-  size_t rxbytes_last = 0, rxbytes = 1, waited = 0;
+size_t CC1101::DrainRXFIFO(bool &complete)
+{
+  const std::lock_guard<std::mutex> lock(rx_mtx);
+  const size_t unknown = (size_t)-1;
 
-  while (true)
-  {
-    do {
-      rxbytes_last = rxbytes;
-      rxbytes = Read(RT->_rRXBYTES);
-    } while (rxbytes != rxbytes_last);
+  complete = false;
 
-    bool overflow = (rxbytes & 0x80) != 0;
-    size_t n = rxbytes & 0x7F;
+  size_t status_sz = (RT->PKTCTRL1() & 0x04) != 0 ? 2 : 0;
 
-    size_t m = n <= 1 ? n : n-1;
+  if (!rx_active) {
+    uint8_t pktctrl0 = RT->PKTCTRL0();
+    if (rx_length != 0)
+      rx_remaining = rx_length + status_sz;
+    else if ((pktctrl0 & 0x3) == 0)
+      rx_remaining = RT->PKTLEN() + status_sz;
+    else
+      rx_remaining = unknown;
+    rx_active = true;
+  }
 
-    if (fixed)
-      m = std::min(m, fixed_size - recv_buf_held());
+  uint8_t rxbytes = ReadFIFOBytes(RT->_rRXBYTES);
 
-    if ((!variable && n == 0) ||
-        (variable && variable_remaining == 0))
-      break;
-    else if (overflow)
-      break;
-    else if (m != 0)
-    {
-      std::vector<uint8_t> buf = Read(RT->_rFIFO.Address(), m);
-      for (uint8_t &bi : buf) {
-        recv_buf[recv_buf_pos++] = bi;
-        recv_buf_pos %= recv_buf_sz;
-      }
-      if (variable) {
-        if (variable_remaining == (size_t)-1) {
-          uint8_t first = recv_buf[recv_buf_begin];
-          if (first == 0)
-            break;
-          else {
-            variable_remaining = first - (m-1);
-            if (status_appended)
-              variable_remaining += 2;
-          }
-        }
-        else
-          variable_remaining -= m;
-      }
-    }
-    else if (waited++ > 5)
-      break;
+  if ((rxbytes & 0x80) != 0) {
+    // Overflow; hand out whatever we have.
+    complete = true;
+    return 0;
+  }
 
-    if (fixed && recv_buf_held() == fixed_size)
-      break;
+  size_t n = rxbytes & 0x7F;
+
+  // Streaming: leave infinite length mode once fewer than 256 bytes are still
+  // in the air, so the packet ends when the byte counter hits PKTLEN.
+  if (rx_length > 255 && !rx_fixed && rx_remaining - std::min(rx_remaining, n + status_sz) < 256) {
+    WriteS(RT->_rPKTCTRL0, RT->PKTCTRL0() & 0xFC);
+    rx_fixed = true;
+  }
 
-    sleep_us(sleep_interval); // give the FIFO a chance to catch up
+  // Don't read the last byte while the packet is still coming in (errata).
+  size_t m = n <= 1 ? n : n-1;
+  if (rx_remaining != unknown && n >= rx_remaining)
+    m = rx_remaining;
+
+  if (m == 0) {
+    // Infinite length mode: the packet ends when the FIFO runs dry.
+    complete = rx_remaining == unknown && (RT->PKTCTRL0() & 0x3) == 2 && recv_buf_held() > 0;
+    return 0;
   }
 
-  // Write(RT->_rPKTCTRL0, pktctrl0_before);
+  uint8_t buf[0x80];
+  Read(RT->_rFIFO.Address(), buf, m);
+  for (size_t i = 0; i < m; i++) {
+    recv_buf[recv_buf_pos++] = buf[i];
+    recv_buf_pos %= recv_buf_sz;
+  }
 
+  if (rx_remaining == unknown && (RT->PKTCTRL0() & 0x3) == 1) {
+    uint8_t length = recv_buf[recv_buf_begin];
+    if (length == 0) {
+      complete = true;
+      return m;
+    }
+    rx_remaining = 1 + length + status_sz - (recv_buf_held() - m);
+  }
+
+  if (rx_remaining != unknown) {
+    rx_remaining -= std::min(m, rx_remaining);
+    complete = rx_remaining == 0;
+  }
+
+  return m;
+}
+
+void CC1101::Receive(std::vector<uint8_t> &packet)
+{
+  if (!rx_ready) {
+    // No GDO interrupt has completed a packet (yet), so poll the FIFO.
+    unsigned sleep_interval = 16 * (1e6 / rDataRate());
+    size_t waited = 0;
+    bool complete = false;
+    while (true) {
+      size_t m = DrainRXFIFO(complete);
+      if (complete || (m == 0 && waited++ > 5))
+        break;
+      sleep_us(sleep_interval); // give the FIFO a chance to catch up
+    }
+  }
+
+  const std::lock_guard<std::mutex> lock(rx_mtx);
   size_t pkt_sz = recv_buf_held(), i=0;
   packet.resize(pkt_sz);
   while (recv_buf_begin != recv_buf_pos) {
@@ -432,45 +540,154 @@ void CC1101::Receive(std::vector<uint8_t> &packet)
   }
 
   recv_buf_begin = recv_buf_pos;
+  rx_active = false;
+  rx_ready = false;
+
+  if (rx_fixed) {
+    // Back to infinite length mode for the next streamed packet.
+    WriteS(RT->_rPKTCTRL0, (RT->PKTCTRL0() & 0xFC) | 0x02);
+    rx_fixed = false;
+  }
+}
+
+void CC1101::SetRXLength(size_t length)
+{
+  if (length > recv_buf_sz - 2)
+    throw std::runtime_error("packet too large for receive buffer");
+
+  const std::lock_guard<std::mutex> lock(rx_mtx);
+  rx_length = length;
+  rx_fixed = false;
+  uint8_t pktctrl0 = RT->PKTCTRL0() & 0xFC;
+  if (length > 255)
+    pktctrl0 |= 0x02;
+  if (length != 0) {
+    RT->Write(RT->_rPKTLEN, length % 256);
+    RT->Write(RT->_rPKTCTRL0, pktctrl0);
+  }
+}
+
+bool CC1101::RXReady()
+{
+  if (gdo0_watcher || gdo2_watcher)
+    return rx_ready;
+  return (Read(RT->_rRXBYTES) & 0x7F) != 0;
+}
+
+bool CC1101::OnGDOEdge()
+{
+  bool complete = false;
+  while (!complete && DrainRXFIFO(complete) > 0);
+
+  if (complete) {
+    rx_ready = true;
+    if (on_packet)
+      on_packet();
+  }
+
+  return true;
+}
+
+void CC1101::EnableInterrupts(const std::string &chip, int gdo0_line, int gdo2_line, std::function<void()> on_packet)
+{
+  DisableInterrupts();
+
+  if (gdo0_line < 0 && gdo2_line < 0)
+    return;
+
+  // 0x00: RX FIFO at or above threshold, 0x01: same or end of packet,
+  // 0x06: asserts on sync word, deasserts at end of packet.
+  if (gdo0_line >= 0 && gdo2_line >= 0) {
+    RT->Write(RT->_rIOCFG0, 0x00);
+    RT->Write(RT->_rIOCFG2, 0x06);
+  }
+  else if (gdo0_line >= 0)
+    RT->Write(RT->_rIOCFG0, 0x01);
+  else
+    RT->Write(RT->_rIOCFG2, 0x01);
+
+  gpio_chip = chip;
+  this->on_packet = on_packet;
+
+  auto handler = [this](int, unsigned, const timespec*, std::shared_ptr<CC1101>&) {
+    return OnGDOEdge();
+  };
+
+  if (gdo0_line >= 0)
+    gdo0_watcher = std::make_unique<GPIOWatcher<CC1101>>(gpio_chip.c_str(), gdo0_line, "WLMCD-CC1101-GDO0", nullptr, true, false, handler);
+  if (gdo2_line >= 0)
+    gdo2_watcher = std::make_unique<GPIOWatcher<CC1101>>(gpio_chip.c_str(), gdo2_line, "WLMCD-CC1101-GDO2", nullptr, gdo0_line < 0, false, handler);
+}
+
+void CC1101::DisableInterrupts()
+{
+  gdo0_watcher.reset();
+  gdo2_watcher.reset();
+  on_packet = nullptr;
 }
 
 void CC1101::Transmit(const std::vector<uint8_t> &pkt)
 {
-  State state_before = (State)RT->MARCSTATE();
-  uint8_t pktlen_before = (State)RT->PKTLEN();
-  StatusByte sb = Strobe(CommandStrobe::SFSTXON, 10);
+  const size_t fifo_sz = 64;
+  uint8_t pktlen_before = RT->PKTLEN();
   uint8_t pktctrl0_before = RT->PKTCTRL0();
+  size_t n = pkt.size();
 
-  uint8_t pkctrl0 = (pktctrl0_before & 0xFC) | (pkt.size() > 256 ? 0x02 : 0x00);
+  // Infinite length mode while more than 255 bytes are left; the hardware
+  // packet counter then stops at PKTLEN (mod 256) once we switch back.
+  bool infinite = n > 255;
+  StatusByte sb = Strobe(CommandStrobe::SFSTXON, 10);
+  sb = WriteS(RT->_rPKTLEN, n % 256);
+  sb = WriteS(RT->_rPKTCTRL0, (pktctrl0_before & 0xFC) | (infinite ? 0x02 : 0x00));
+
+  // Refill whenever the FIFO has drained to the TX threshold, sleeping for as
+  // long as that takes at the configured data rate.
+  size_t threshold = fifo_sz - 3 - 4 * (RT->FIFOTHR() & 0x0F);
+  double byte_us = 8e6 / rDataRate();
+
+  size_t sent = std::min(fifo_sz, n);
+  sb = WriteS(RT->_rFIFO, pkt.data(), sent);
+  sb = Strobe(CommandStrobe::STX);
+
+  size_t level = sent;
+  while (sent < n) {
+    uint8_t txbytes = ReadFIFOBytes(RT->_rTXBYTES);
+    if ((txbytes & 0x80) != 0)
+      break;
+    level = txbytes & 0x7F;
 
-  sb = WriteS(RT->_rPKTLEN, pkt.size() % 256);
+    if (infinite && n - sent + level < 256) {
+      sb = WriteS(RT->_rPKTCTRL0, pktctrl0_before & 0xFC);
+      infinite = false;
+    }
 
-  size_t sent = 0;
-  while (sent < pkt.size() &&
-    sb.State() != StatusByte::SState::TXFIFO_UNDERFLOW &&
-    sb.State() != StatusByte::SState::RXFIFO_OVERFLOW)
-  {
-    sb = Strobe(CommandStrobe::STX);
-    size_t to_send = std::min((size_t)sb.FIFO_BYTES_AVAILABLE(), pkt.size() - sent);
-    if (to_send > 0) {
-      const auto first = pkt.begin() + sent;
-      const auto last = first + to_send;
-      sb = WriteS(RT->_rFIFO, std::vector<uint8_t>(first, last));
-      sent += to_send;
+    size_t chunk = std::min(fifo_sz - level, n - sent);
+    if (chunk > 0) {
+      sb = WriteS(RT->_rFIFO, pkt.data() + sent, chunk);
+      sent += chunk;
+      level += chunk;
     }
-    size_t remaining = pkt.size() - sent;
-    if (0 < remaining && remaining < 256)
-      sb = WriteS(RT->_rPKTCTRL0, pktctrl0_before & 0xFC);
+
+    if (sb.State() == StatusByte::SState::TXFIFO_UNDERFLOW)
+      break;
+
+    if (level > threshold)
+      sleep_us((level - threshold) * byte_us);
   }
 
+  // Wait for the rest of the FIFO to go out.
+  sleep_us(level * byte_us);
   size_t cnt = 0;
   do {
-    sleep_us(500);
     sb = Strobe(CommandStrobe::SNOP);
-    cnt++;
+    if (sb.State() != StatusByte::SState::TX)
+      break;
+    sleep_us(8 * byte_us);
   }
-  while (sb.FIFO_BYTES_AVAILABLE() < 64 &&
-         sb.State() == StatusByte::SState::TX);
+  while (++cnt < 50);
+
+  if (sb.State() == StatusByte::SState::TXFIFO_UNDERFLOW)
+    Strobe(CommandStrobe::SFTX);
 
   Write(RT->_rPKTCTRL0, pktctrl0_before);
   Write(RT->_rPKTLEN, pktlen_before);
@@ -504,9 +721,10 @@ void CC1101::inc_frequency() {
   fr = (fr + 1) & 0x3FFFFF;
   if (fr == 0)
     return;
-  Write(RT->_rFREQ2, (fr >> 16) & 0x3F);
-  Write(RT->_rFREQ1, (fr >> 8) & 0xFF);
-  Write(RT->_rFREQ0, fr & 0xFF);
+  RT->Stage(RT->_rFREQ2, (fr >> 16) & 0x3F);
+  RT->Stage(RT->_rFREQ1, (fr >> 8) & 0xFF);
+  RT->Stage(RT->_rFREQ0, fr & 0xFF);
+  RT->Flush();
   UpdateFrequent();
 }
 
@@ -515,9 +733,10 @@ void CC1101::dec_frequency() {
   if (fr == 0)
     return;
   fr = (fr - 1) & 0x3FFFFF;
-  Write(RT->_rFREQ2, (fr >> 16) & 0x3F);
-  Write(RT->_rFREQ1, (fr >> 8) & 0xFF);
-  Write(RT->_rFREQ0, fr & 0xFF);
+  RT->Stage(RT->_rFREQ2, (fr >> 16) & 0x3F);
+  RT->Stage(RT->_rFREQ1, (fr >> 8) & 0xFF);
+  RT->Stage(RT->_rFREQ0, fr & 0xFF);
+  RT->Flush();
   UpdateFrequent();
 }
 
@@ -531,8 +750,9 @@ void CC1101::inc_datarate()
   drate_m++;
   if (drate_m == 0x00)
     drate_e++;
-  Write(RT->_rMDMCFG4, (mdmcfg4 & 0xF0) | drate_e);
-  Write(RT->_rMDMCFG3, drate_m);
+  RT->Stage(RT->_rMDMCFG4, (mdmcfg4 & 0xF0) | drate_e);
+  RT->Stage(RT->_rMDMCFG3, drate_m);
+  RT->Flush();
 }
 
 void CC1101::dec_datarate()
@@ -545,8 +765,9 @@ void CC1101::dec_datarate()
   drate_m--;
   if (drate_m == 0xFF)
     drate_e--;
-  Write(RT->_rMDMCFG4, (mdmcfg4 & 0xF0) | drate_e);
-  Write(RT->_rMDMCFG3, drate_m);
+  RT->Stage(RT->_rMDMCFG4, (mdmcfg4 & 0xF0) | drate_e);
+  RT->Stage(RT->_rMDMCFG3, drate_m);
+  RT->Flush();
 }
 
 void CC1101::RegisterTable::Refresh(bool frequent)
@@ -562,8 +783,22 @@ void CC1101::RegisterTable::Refresh(bool frequent)
     memcpy(buffer.data(), tmp.data(), 47);
     device.RT->PATableBuffer = device.Read(device.RT->_rPATABLE, 8);
   }
-  for (size_t i=0; i < 14; i++)
-    buffer[0xC0 | (0x30 + i)] = device.Read(0xC0 | (0x30 + i));
+
+  // Status registers can't be burst-read, but the single reads can share an ioctl.
+  const size_t num_status = 14;
+  uint8_t status[num_status][2];
+  {
+    const std::lock_guard<std::mutex> lock(device.mtx);
+    SPIDev::Transaction t(device, num_status);
+    for (size_t i=0; i < num_status; i++) {
+      status[i][0] = 0xC0 | (0x30 + i);
+      status[i][1] = 0;
+      t.Add(status[i], 2, i + 1 < num_status);
+    }
+    t.Submit();
+  }
+  for (size_t i=0; i < num_status; i++)
+    buffer[0xC0 | (0x30 + i)] = status[i][1];
 }
 
 void CC1101::RegisterTable::Write(std::ostream &os) const
@@ -596,16 +831,21 @@ void CC1101::RegisterTable::Read(std::istream &is)
   json j = json::parse(is);
   if (j["device"]["name"] != device.Name())
     throw std::runtime_error("device mismatch");
-  for (const auto &e : j["registers"].items()) {
-    if (!e.value().is_string())
-      throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
-    std::string sval = e.value().get<std::string>();
-    if ((e.key() != "PATABLE" && sval.size() != 2) ||
-        (e.key() == "PATABLE" && sval.size() != 16))
-      throw std::runtime_error(std::string("invalid value length for '" + e.key() + "'"));
-    bool found = false;
-    for (const auto reg : registers)
-      if (reg->Name() == e.key() && reg != &device.RT->_rFIFO && reg->Writeable()) {
+
+  // Only registers that change are written, in bursts.
+  Refresh(false);
+
+  try {
+    for (const auto &e : j["registers"].items()) {
+      if (!e.value().is_string())
+        throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
+      std::string sval = e.value().get<std::string>();
+      if ((e.key() != "PATABLE" && sval.size() != 2) ||
+          (e.key() == "PATABLE" && sval.size() != 16))
+        throw std::runtime_error(std::string("invalid value length for '" + e.key() + "'"));
+      bool found = false;
+      auto reg = Find(e.key());
+      if (reg && reg != &device.RT->_rFIFO && reg->Writeable()) {
         uint8_t val;
         if (reg == &device.RT->_rPATABLE)
         {
@@ -616,15 +856,21 @@ void CC1101::RegisterTable::Read(std::istream &is)
           }
           device.Write(device.RT->_rPATABLE, patable);
         }
-        else if (reg->Writeable()) {
+        else {
           sscanf(sval.c_str(), "%02hhx", &val);
-          device.Write(*reg, val);
+          Stage(*reg, val);
         }
         found = true;
-        break;
       }
-    if (!found) {
-      throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
+      if (!found) {
+        throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
+      }
     }
   }
+  catch (...) {
+    Flush();
+    throw;
+  }
+
+  Flush();
 }
@@ -7,7 +7,9 @@
 #include <ostream>
 #include <mutex>
 #include <stdexcept>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <thread>
 
 #include "device.h"
@@ -75,6 +77,22 @@ protected:
   uint8_t *recv_buf;
   size_t recv_buf_sz, recv_buf_begin, recv_buf_pos;
   mutable std::mutex mtx;
+  std::atomic<uint8_t> status;
+
+  // RX state, shared between Receive and the GDO edge handlers.
+  std::mutex rx_mtx;
+  bool rx_active;
+  size_t rx_remaining;
+  std::atomic<bool> rx_ready;
+  size_t rx_length;
+  bool rx_fixed;
+  std::string gpio_chip;
+  std::unique_ptr<GPIOWatcher<CC1101>> gdo0_watcher, gdo2_watcher;
+  std::function<void()> on_packet;
+
+  uint8_t ReadFIFOBytes(const Register<uint8_t, uint8_t> &reg);
+  size_t DrainRXFIFO(bool &complete);
+  bool OnGDOEdge();
 
   inline size_t recv_buf_held() const {
     return recv_buf_begin <= recv_buf_pos ?
@@ -168,15 +186,23 @@ public:
   Config GetConfig();
 
   StatusByte Strobe(CommandStrobe cs, size_t delay_ms = 0);
+  StatusByte Strobe(CommandStrobe first, CommandStrobe second, size_t delay_us = 0);
   StatusByte StrobeFor(CommandStrobe cs, State st, size_t delay_ms = 0);
+  // For MARCSTATE states that the status byte doesn't tell apart.
+  StatusByte StrobeForMARCSTATE(CommandStrobe cs, State st, size_t delay_us = 0);
+
+  // The status byte that came back with the most recent SPI transfer.
+  StatusByte LastStatus() const { return StatusByte(status); }
 
   virtual const char* Name() const override { return "CC1101"; }
+  virtual std::string Bus() const override { return SPIDev::Bus(); }
 
   using Device::Read;
   using Device::Write;
 
   virtual uint8_t Read(const uint8_t &addr) override;
   virtual std::vector<uint8_t> Read(const uint8_t &addr, size_t length) override;
+  void Read(const uint8_t &addr, uint8_t *out, size_t length);
 
   virtual void Write(const uint8_t &addr, const uint8_t &value) override { WriteS(addr, value); }
   virtual void Write(const uint8_t &addr, const std::vector<uint8_t> &values) override { WriteS(addr, values); }
@@ -185,6 +211,8 @@ public:
   StatusByte WriteS(Register<uint8_t, uint8_t> &reg, const uint8_t &value);
   StatusByte WriteS(const uint8_t &addr, const std::vector<uint8_t> &values);
   StatusByte WriteS(Register<uint8_t, uint8_t> &reg, const std::vector<uint8_t> &values);
+  StatusByte WriteS(const uint8_t &addr, const uint8_t *values, size_t n);
+  StatusByte WriteS(Register<uint8_t, uint8_t> &reg, const uint8_t *values, size_t n);
 
   static std::string StateName(State st);
 
@@ -227,7 +255,20 @@ public:
   virtual double RSSI() override { return rRSSI(); }
   virtual double LQI() override { return rLQI(); }
 
-  virtual bool RXReady() override { return false; }
+  // Configures GDO0 as RX FIFO threshold and GDO2 as sync/end-of-packet
+  // interrupt (or whichever one is wired, as threshold-or-end-of-packet)
+  // and drains the RX FIFO on their edges. A line offset < 0 means the pin
+  // isn't connected. `on_packet` is called from the watcher thread once a
+  // packet is complete and can be picked up with Receive.
+  void EnableInterrupts(const std::string &chip, int gdo0_line, int gdo2_line, std::function<void()> on_packet = nullptr);
+  void DisableInterrupts();
+
+  // Expected payload length for streaming receive in infinite length mode,
+  // which also covers packets longer than 255 bytes. With 0, the packet
+  // format in PKTCTRL0/PKTLEN applies as configured.
+  void SetRXLength(size_t length);
+
+  virtual bool RXReady() override;
 };
 
 #endif
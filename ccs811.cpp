@@ -67,9 +67,13 @@ void CCS811::UpdateTimed()
 
 void CCS811::RegisterTable::Refresh(bool frequent)
 {
+  // Register widths are known here, no need to look them up for every read.
   for (auto& r : registers) {
-    if (r->Readable())
-      buffer[r->Address()] = device.Read(r->Address());
+    if (r->Readable()) {
+      std::vector<uint8_t> &b = buffer[r->Address()];
+      b.resize(r->value_size());
+      device.ReadBlock(r->Address(), b.data(), b.size());
+    }
   }
 }
 
@@ -130,21 +134,12 @@ void CCS811::RegisterTable::Read(std::istream &is)
 std::vector<uint8_t> CCS811::Read(const uint8_t &addr)
 {
   size_t value_size = RT->Find(addr)->value_size();
-  uint8_t buf[1] = {addr};
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, buf, 1) != 1)
-    throw_errno("failed to write to the I2C bus");
   std::vector<uint8_t> r(value_size);
-  if ((size_t)read(fd, r.data(), value_size) != value_size)
-    throw_errno("failed to read from the I2C bus");
+  ReadBlock(addr, r.data(), value_size);
   return r;
 }
 
 void CCS811::Write(const uint8_t &addr, const std::vector<uint8_t> &value)
 {
-  std::vector<uint8_t> buf = value;
-  buf.insert(buf.begin(), addr);
-  std::lock_guard<std::mutex> lock(mtx);
-  if ((size_t)write(fd, buf.data(), buf.size()) != buf.size())
-    throw_errno("failed to write to the I2C bus");
+  WriteBlock(addr, value.data(), value.size());
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 #include "register_table.h"
 
 #define REG(N, P, A, SZ, RW, H, V) VREGDECL(uint8_t, SZ, N, P, A, RW, H, V)
-#define VAR(R, N, NN, M, RW, D) VARDECL(uint8_t, std::vector<uint8_t>, R, N, NN, M, RW, D)
+#define VAR(R, N, NN, M, RW, D) VVARDECL(uint8_t, std::vector<uint8_t>, R, N, NN, M, RW, D)
 
 static const std::vector<uint8_t> ECO2_MASK =     { 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 static const std::vector<uint8_t> TVOC_MASK =     { 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00 };
@@ -2,8 +2,19 @@
 // Licensed under the MIT License.
 
 #include <unistd.h>
-
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <cinttypes>
 #include <cmath>
+#include <cstring>
 #include <csignal>
 #include <ctime>
 #include <stdexcept>
@@ -15,94 +26,32 @@
 #include <curses.h>
 
 #include "sleep.h"
+#include "errors.h"
 #include "device.h"
 #include "ui.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "update_pool.h"
+#include "scheduler.h"
 #include "controller.h"
 
 #define KEY_FUN [](auto ctrl, auto ui, auto d, auto e)
 
-static volatile bool have_timer = false;
-static volatile bool timed_out = false;
-static timer_t timerid;
-static sigset_t sigmask_timer, sigmask_empty;
+// frequent_interval and infrequent_interval are counted in ticks of this length.
+static const uint64_t tick_ns = 11000000;
 
-static void timer_handler(int sig, siginfo_t *si, void *uc)
+static uint64_t monotonic_ns()
 {
-  timed_out = true;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
 }
 
-static void timer_setup(double frequency)
+static uint64_t period_ns(double frequency)
 {
-    struct sigevent sev;
-    struct sigaction sa;
-    int signal = SIGRTMIN;
-
-    sigemptyset(&sigmask_empty);
-    sigemptyset(&sigmask_timer);
-    sigaddset(&sigmask_timer, signal);
-
-    // Set up handler
-    sa.sa_flags = SA_SIGINFO;
-    sa.sa_sigaction = timer_handler;
-    sigemptyset(&sa.sa_mask);
-    if (sigaction(signal, &sa, NULL) == -1)
-      throw std::runtime_error("sigaction");
-
-    // Create timer
-    sev.sigev_notify = SIGEV_SIGNAL;
-    sev.sigev_signo = signal;
-    sev.sigev_value.sival_ptr = &timerid;
-    if (timer_create(CLOCK_REALTIME, &sev, &timerid) == -1)
-      throw std::runtime_error("timer_create");
-
-    // Start timer
-    double period = 1.0 / frequency;
-    double seconds = 0.0;
-    double fraction = modf(period, &seconds);
-    struct itimerspec its;
-    its.it_value.tv_sec = seconds;
-    its.it_value.tv_nsec = round(fraction * 1e9);
-    its.it_interval.tv_sec = its.it_value.tv_sec;
-    its.it_interval.tv_nsec = its.it_value.tv_nsec;
-
-    if (timer_settime(timerid, 0, &its, NULL) == -1)
-      throw std::runtime_error("timer_settime");
-
-    // Unblock signal delivery
-    if (sigprocmask(SIG_UNBLOCK, &sigmask_timer, NULL) == -1)
-      throw std::runtime_error("sigprocmask");
-
-    have_timer = true;
+  return frequency != 0 ? std::llround(1e9 / frequency) : UINT64_MAX;
 }
 
-class UpdateThread {
-public:
-  UpdateThread(std::shared_ptr<DeviceBase> device) : device(device), done(false) {
-    auto f = [=](std::shared_ptr<DeviceBase> device) {
-      try {
-        device->UpdateTimed();
-      }
-      catch (std::exception &ex) {
-        UI::Log("Exception during threaded update: %s", ex.what());
-      }
-      catch (...) {
-        UI::Log("Unknown exception during threaded update");
-      }
-      done = true;
-    };
-    thread = std::thread(f, device);
-  }
-  virtual ~UpdateThread() {}
-  bool Done() const { return done; }
-  void Join() { if (thread.joinable()) thread.join(); }
-protected:
-  std::thread thread;
-  std::shared_ptr<DeviceBase> device;
-  bool done;
-};
-
 Controller::Controller(
   double frequency,
   size_t frequent_interval,
@@ -111,15 +60,52 @@ Controller::Controller(
   infrequent_interval(infrequent_interval),
   frequency(frequency),
   running(false),
-  cur_frequent_interval(frequent_interval),
-  cur_infrequent_interval(infrequent_interval),
-  cur_frequency(frequency),
   ui_inx(SIZE_MAX),
   decoder_inx(SIZE_MAX),
-  encoder_inx(SIZE_MAX)
+  encoder_inx(SIZE_MAX),
+  epoll_fd(-1),
+  timer_fd(-1),
+  signal_fd(-1),
+  event_fd(-1),
+  listen_fd(-1),
+  reschedule(true),
+  last_completed(0),
+  last_overruns(0)
 {
-  if (!have_timer && cur_frequency != 0)
-    timer_setup(cur_frequency);
+  if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+    throw_errno("epoll_create1");
+
+  if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+    throw_errno("timerfd_create");
+
+  sigemptyset(&signal_mask);
+  sigaddset(&signal_mask, SIGINT);
+  sigaddset(&signal_mask, SIGTERM);
+  if ((signal_fd = signalfd(-1, &signal_mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
+    throw_errno("signalfd");
+
+  if ((event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    throw_errno("eventfd");
+
+  for (int fd : { timer_fd, signal_fd, event_fd }) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+      throw_errno("epoll_ctl");
+  }
+
+  // stdin may not be pollable (e.g. /dev/null); then we just never see keys.
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = STDIN_FILENO;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &ev);
+
+  pool = std::make_unique<UpdatePool>(0, [this]() { Wake(); });
+  scheduler = std::make_unique<Scheduler>(*pool);
+  scheduler->SetDefaults(period_ns(frequency),
+                         frequent_interval * tick_ns,
+                         infrequent_interval * tick_ns);
 
   key_bindings['q'] = KEY_FUN {
     ctrl->Stop();
@@ -128,17 +114,8 @@ Controller::Controller(
   key_bindings['r'] =
   key_bindings[KEY_REFRESH] =
   key_bindings[KEY_RESIZE] = KEY_FUN {
-    ctrl->cur_frequent_interval = ctrl->frequent_interval;
-    ctrl->cur_infrequent_interval = ctrl->infrequent_interval;
-    ctrl->cur_frequency = ctrl->frequency;
-    if (ctrl->frequency != 0) {
-      for (auto d : ui->Devices()) {
-        d->UpdateTimed();
-        d->UpdateFrequent();
-        d->UpdateInfrequent();
-      }
-    }
-
+    ctrl->scheduler->ResetBackoff();
+    ctrl->reschedule = true;
     ui->Reset();
   };
 
@@ -156,85 +133,13 @@ Controller::Controller(
   key_bindings[KEY_RIGHT] = KEY_FUN { ui->Right(); };
 
   key_bindings['\n'] =
-  key_bindings[KEY_ENTER] = KEY_FUN {
-    ctrl->PauseTimer();
-    ui->Edit();
-    ctrl->ResumeTimer();
-  };
+  key_bindings[KEY_ENTER] = KEY_FUN { ui->Edit(); };
 
   key_bindings['d'] = KEY_FUN { ui->Describe(); };
   key_bindings['h'] = KEY_FUN { ui->Describe(); };
 
   key_bindings[':'] = KEY_FUN {
-    // Disable timer; because wgetnstr apparently gets
-    // interrupted by real-time signals.
-    ctrl->PauseTimer();
-    std::string cmd = ui->GetCommand();
-    ctrl->ResumeTimer();
-
-    std::string verb, args;
-    if (cmd.size() > 0)
-    {
-      size_t fpos = cmd.find(' ');
-      verb = cmd.substr(0, fpos);
-      args = fpos == std::string::npos ? "" : cmd.substr(fpos + 1);
-
-      while (std::isspace(args[0]))
-        args = args.substr(1);
-
-      if (verb == "q" || verb == "quit")
-        ctrl->Stop();
-      else if (verb == "w" || verb == "write") {
-        try {
-          std::ofstream f(args);
-          auto devs = ui->Devices();
-          if (devs.size() == 0)
-            UI::Error("No devices");
-          else if (devs.size() == 1)
-            (*devs.begin())->Write(f);
-          else {
-            f << "{\n  \"devices\": [\n";
-            for (auto it = devs.begin(); it != devs.end(); it++) {
-              if (it != devs.begin())
-                f << ",\n";
-              (*it)->Write(f);
-            }
-            f << "  ]\n}\n";
-          }
-          f.close();
-          UI::Log("Wrote configuration to %s", args.c_str());
-        }
-        catch (std::exception &ex) {
-          UI::Error("%s", ex.what());
-        }
-      }
-      else if (verb == "r" || verb == "read") {
-        try {
-          if (ui->Devices().size() > 1)
-            UI::Error("Cannot read configurations of multiple devices");
-          for (auto device : ui->Devices()) {
-            auto is = std::ifstream(args);
-            device->Read(is);
-          }
-          UI::Log("Read configuration from %s", args.c_str());
-        }
-        catch (std::exception &ex) {
-          UI::Error("%s", ex.what());
-        }
-      }
-      else if (verb == "R" || verb == "reset") {
-        for (auto device : ui->Devices())
-          device->Reset();
-      }
-      else {
-        auto cit = ctrl->commands.find(verb);
-        if (cit != ctrl->commands.end()) {
-          cit->second(args);
-        }
-        else
-          UI::Error("Unknown command '%s'", verb.c_str());
-      }
-    }
+    ctrl->Execute(ui->GetCommand());
   };
 
   key_bindings[' '] = KEY_FUN {
@@ -245,16 +150,12 @@ Controller::Controller(
   };
 
   key_bindings['/'] = KEY_FUN {
-    ctrl->PauseTimer();
     ctrl->last_search = ui->GetCommand("/");
-    ctrl->ResumeTimer();
     ui->FindNext(ctrl->last_search);
   };
 
   key_bindings['?'] = KEY_FUN {
-    ctrl->PauseTimer();
     ctrl->last_search = ui->GetCommand("?");
-    ctrl->ResumeTimer();
     ui->FindPrev(ctrl->last_search);
   };
 
@@ -270,6 +171,17 @@ Controller::Controller(
 Controller::~Controller()
 {
   Stop();
+  scheduler.reset();
+  pool.reset();
+  for (auto &kv : clients)
+    close(kv.first);
+  if (listen_fd != -1) {
+    close(listen_fd);
+    unlink(listen_path.c_str());
+  }
+  for (int fd : { event_fd, signal_fd, timer_fd, epoll_fd })
+    if (fd != -1)
+      close(fd);
 }
 
 void Controller::AddSystem(
@@ -287,6 +199,8 @@ bool Controller::SelectSystem(size_t inx)
   if (inx >= uis.size())
     return false;
 
+  if (inx != ui_inx)
+    reschedule = true;
   ui_inx = decoder_inx = encoder_inx = inx;
   return true;
 }
@@ -317,180 +231,350 @@ void Controller::PreviousUI()
   }
 }
 
-void Controller::ThreadCleanup()
+void Controller::Schedule(uint64_t now)
 {
-  const std::lock_guard<std::mutex> lock(threads_mtx);
-  try {
-    if (!threads.empty()) {
-      std::set<UpdateThread*> joined;
-      for (UpdateThread *t : threads) {
-        if (t && t->Done()) {
-          t->Join();
-          delete(t);
-          joined.insert(t);
-        }
-      }
-      for (UpdateThread *t : joined)
-        threads.erase(t);
-      if (threads.empty() && ui_inx < uis.size())
-        uis[ui_inx]->Update(false);
-    }
+  // Headless, nobody looks at a particular UI, so all devices are kept up to date.
+  std::vector<std::shared_ptr<DeviceBase>> devices;
+  auto add = [&devices](const std::shared_ptr<DeviceBase> &device) {
+    if (std::find(devices.begin(), devices.end(), device) == devices.end())
+      devices.push_back(device);
+  };
+  for (size_t i = 0; i < uis.size(); i++)
+    if (i == ui_inx || UI::Headless())
+      for (auto &device : uis[i]->Devices())
+        add(device);
+  for (auto &device : background_devices)
+    add(device);
+  scheduler->SetDevices(devices, now);
+  reschedule = false;
+}
+
+void Controller::ReportOverruns()
+{
+  uint64_t overruns = pool->Overruns();
+  if (overruns != last_overruns) {
+    // Log at 1, 2, 4, 8, ... so that a persistently slow device doesn't flood the log.
+    if ((overruns & (overruns - 1)) == 0)
+      UI::Log("Update overrun; %" PRIu64 " update(s) coalesced so far", overruns);
+    last_overruns = overruns;
   }
-  catch (std::exception &ex) {
-    UI::Log("Exception during background thread cleanup: %s", ex.what());
+}
+
+uint64_t Controller::Overruns() const
+{
+  return pool->Overruns();
+}
+
+void Controller::ArmTimer(uint64_t deadline)
+{
+  struct itimerspec its = {};
+  if (deadline != UINT64_MAX) {
+    deadline = std::max(deadline, (uint64_t)1);
+    its.it_value.tv_sec = deadline / 1000000000ull;
+    its.it_value.tv_nsec = deadline % 1000000000ull;
+  }
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+    throw_errno("timerfd_settime");
+}
+
+void Controller::HandleKey(int key)
+{
+  auto kit = key_bindings.find(key);
+  if (kit != key_bindings.end())
+    kit->second(this, uis[ui_inx], decoders[decoder_inx], encoders[encoder_inx]);
+  else if (KEY_F(1) <= key && key <= KEY_F(64))
+  {
+    size_t inx = key - KEY_F0 - 1;
+    if (inx >= uis.size())
+      UI::Error("No such UI");
+    else if (ui_inx != inx)
+    {
+      SelectSystem(inx);
+      uis[ui_inx]->Reset();
+    }
   }
-  catch (...) {
-    UI::Log("Caught unknown exception during background thread cleanup");
+}
+
+void Controller::HandleSignals()
+{
+  struct signalfd_siginfo si;
+  while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+    if (on_signal)
+      on_signal(si.ssi_signo);
+    else
+      Stop();
   }
 }
 
 void Controller::Run()
 {
-  if (uis.size() == 0)
+  bool headless = UI::Headless();
+
+  if (uis.size() == 0 && !headless)
     throw std::runtime_error("No UI to run.");
 
   SelectSystem(0);
   running = true;
-  timed_out = true;
-  uis[ui_inx]->Reset();
+  if (!headless)
+    uis[ui_inx]->Reset();
 
-  for (size_t i = 0; running; i++)
+  // SIGINT/SIGTERM arrive on signal_fd while we're running.
+  sigset_t old_mask;
+  pthread_sigmask(SIG_BLOCK, &signal_mask, &old_mask);
+
+  // Headless, stdin carries commands, one per line.
+  int stdin_flags = fcntl(STDIN_FILENO, F_GETFL);
+  if (headless && stdin_flags != -1)
+    fcntl(STDIN_FILENO, F_SETFL, stdin_flags | O_NONBLOCK);
+
+  while (running)
   {
     try {
-      UI::indicator_value = threads.size();
-
-      int key = uis[ui_inx]->GetKey();
-      if (key != ERR)
-      {
-        auto kit = key_bindings.find(key);
-        if (kit != key_bindings.end())
-          kit->second(this, uis[ui_inx], decoders[decoder_inx], encoders[encoder_inx]);
-        else if (KEY_F(1) <= key && key <= KEY_F(64))
-        {
-          size_t inx = key - KEY_F0 - 1;
-          if (inx >= uis.size())
-            UI::Error("No such UI");
-          else if (ui_inx != inx)
-          {
-            SelectSystem(inx);
-            uis[ui_inx]->Reset();
-          }
+      UI::indicator_value = pool->InFlight();
+
+      if (reschedule)
+        Schedule(monotonic_ns());
+
+      ArmTimer(scheduler->NextDeadline());
+
+      struct epoll_event events[4];
+      int n = epoll_wait(epoll_fd, events, 4, -1);
+      // EINTR: most likely SIGWINCH, for which curses has queued a KEY_RESIZE.
+      bool have_keys = !headless && n == -1 && errno == EINTR;
+      if (n == -1 && errno != EINTR)
+        throw_errno("epoll_wait");
+
+      for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        uint64_t cnt;
+        if (fd == STDIN_FILENO && !headless)
+          have_keys = true;
+        else if (fd == STDIN_FILENO || clients.find(fd) != clients.end())
+          ReadCommands(fd);
+        else if (fd == listen_fd)
+          AcceptClient();
+        else if (fd == signal_fd)
+          HandleSignals();
+        else if (fd == timer_fd || fd == event_fd) {
+          if (read(fd, &cnt, sizeof(cnt)) != sizeof(cnt) && errno != EAGAIN)
+            throw_errno("read");
         }
       }
 
-      if (i % cur_frequent_interval == 0)
-      {
-        try {
-          for (auto &device : uis[ui_inx]->Devices())
-            device->UpdateFrequent();
-          for (auto &device : background_devices)
-            device->UpdateFrequent();
-          uis[ui_inx]->Update(false);
-        }
-        catch (std::exception &ex) {
-          UI::Log("Exception: %s", ex.what());
-          i = 0;
-          cur_frequent_interval *= 2;
-        }
-      }
-      else if (i % cur_infrequent_interval == 0)
-      {
-        try {
-          for (auto &device : uis[ui_inx]->Devices())
-            device->UpdateInfrequent();
-          for (auto &device : background_devices)
-            device->UpdateInfrequent();
-          uis[ui_inx]->Update(false);
-        }
-        catch (std::exception &ex) {
-          UI::Log("Exception: %s", ex.what());
-          i = 0;
-          cur_infrequent_interval *= 2;
-        }
-      }
+      if (!running)
+        break;
 
-      if (have_timer && timed_out)
-      {
-        timed_out = false;
-        ThreadCleanup();
-        try {
-          const std::lock_guard<std::mutex> lock(threads_mtx);
-          for (auto &device : uis[ui_inx]->Devices()) {
-            UpdateThread *t = new UpdateThread(device);
-            if (t == NULL)
-              throw std::runtime_error("could not spawn thread");
-            threads.insert(t);
-          }
-          for (auto &device : background_devices) {
-            UpdateThread *t = new UpdateThread(device);
-            if (t == NULL)
-              throw std::runtime_error("could not spawn thread");
-            threads.insert(t);
-          }
-        }
-        catch (std::exception &ex) {
-          UI::Log("Exception during background thread creation: %s", ex.what());
-        }
-        catch (...) {
-          UI::Log("Caught unknown exception during background thread creation");
-        }
+      if (have_keys) {
+        int key;
+        while (running && (key = uis[ui_inx]->GetKey()) != ERR)
+          HandleKey(key);
+        if (!running)
+          break;
       }
 
-      sleep_ms(11);
+      if (reschedule)
+        Schedule(monotonic_ns());
+
+      scheduler->Dispatch(monotonic_ns());
+      ReportOverruns();
+
+      uint64_t completed = pool->Completed();
+      if (completed != last_completed) {
+        last_completed = completed;
+        Update(false);
+      }
     }
     catch (std::exception &ex) {
       UI::Log("Exception: %s", ex.what());
-      uis[ui_inx]->Update(false);
+      Update(false);
       sleep_ms(250);
     }
     catch (...) {
       UI::Log("Caught unknown exception.");
-      uis[ui_inx]->Update(false);
+      Update(false);
       sleep_ms(250);
     }
   }
 
+  ArmTimer(UINT64_MAX);
+  pool->Wait();
+  if (headless && stdin_flags != -1)
+    fcntl(STDIN_FILENO, F_SETFL, stdin_flags);
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
   ui_inx = SIZE_MAX;
   running = false;
-  timed_out = false;
 }
 
-void Controller::Stop()
+void Controller::Listen(const std::string &path)
 {
-  if (have_timer) {
-    timer_delete(timerid);
-    size_t num_threads = threads.size();
-    size_t last = num_threads;
-    while (num_threads > 0) {
-      ThreadCleanup();
-      if (num_threads != last) {
-        UI::Info("threads to join: %lu", num_threads);
-        if (ui_inx != SIZE_MAX)
-          uis[ui_inx]->Update(false);
-      }
-      sleep_ms(10);
-      last = num_threads;
-      num_threads = threads.size();
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("control socket path too long");
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  if (listen_fd != -1)
+    throw std::runtime_error("already listening");
+
+  if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+    throw_errno("socket");
+
+  unlink(path.c_str());
+  if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(listen_fd, 4) == -1) {
+    close(listen_fd);
+    listen_fd = -1;
+    throw_errno("could not listen on control socket");
+  }
+  listen_path = path;
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = listen_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+    throw_errno("epoll_ctl");
+}
+
+void Controller::AcceptClient()
+{
+  int fd;
+  while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      close(fd);
+      throw_errno("epoll_ctl");
+    }
+    clients[fd] = "";
+  }
+}
+
+void Controller::ReadCommands(int fd)
+{
+  std::string &buf = fd == STDIN_FILENO ? stdin_buffer : clients[fd];
+  char tmp[256];
+  ssize_t n;
+
+  while ((n = read(fd, tmp, sizeof(tmp))) > 0) {
+    buf.append(tmp, n);
+    size_t pos;
+    while ((pos = buf.find('\n')) != std::string::npos) {
+      std::string cmd = buf.substr(0, pos);
+      buf.erase(0, pos + 1);
+      while (!cmd.empty() && std::isspace(cmd.back()))
+        cmd.pop_back();
+      Execute(cmd);
     }
   }
+
+  if (n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    if (fd != STDIN_FILENO) {
+      close(fd);
+      clients.erase(fd);
+    }
+  }
+}
+
+void Controller::Stop()
+{
   running = false;
+  Wake();
 }
 
-void Controller::AddBackgroundDevice(std::shared_ptr<DeviceBase> device)
+void Controller::Wake()
 {
-  background_devices.insert(device);
+  // Async-signal-safe; may be called from any thread or signal handler.
+  uint64_t one = 1;
+  if (event_fd != -1)
+    (void)!write(event_fd, &one, sizeof(one));
+}
+
+void Controller::OnSignal(std::function<void(int)> f)
+{
+  on_signal = f;
+}
+
+void Controller::Execute(const std::string &cmd)
+{
+  std::string verb, args;
+  if (cmd.size() > 0)
+  {
+    size_t fpos = cmd.find(' ');
+    verb = cmd.substr(0, fpos);
+    args = fpos == std::string::npos ? "" : cmd.substr(fpos + 1);
+
+    while (std::isspace(args[0]))
+      args = args.substr(1);
+
+    if (verb == "q" || verb == "quit")
+      Stop();
+    else if (verb == "w" || verb == "write") {
+      try {
+        std::ofstream f(args);
+        auto devs = Devices();
+        if (devs.size() == 0)
+          UI::Error("No devices");
+        else if (devs.size() == 1)
+          (*devs.begin())->Write(f);
+        else {
+          f << "{\n  \"devices\": [\n";
+          for (auto it = devs.begin(); it != devs.end(); it++) {
+            if (it != devs.begin())
+              f << ",\n";
+            (*it)->Write(f);
+          }
+          f << "  ]\n}\n";
+        }
+        f.close();
+        UI::Log("Wrote configuration to %s", args.c_str());
+      }
+      catch (std::exception &ex) {
+        UI::Error("%s", ex.what());
+      }
+    }
+    else if (verb == "r" || verb == "read") {
+      try {
+        if (Devices().size() > 1)
+          UI::Error("Cannot read configurations of multiple devices");
+        for (auto device : Devices()) {
+          auto is = std::ifstream(args);
+          device->Read(is);
+        }
+        UI::Log("Read configuration from %s", args.c_str());
+      }
+      catch (std::exception &ex) {
+        UI::Error("%s", ex.what());
+      }
+    }
+    else if (verb == "R" || verb == "reset") {
+      for (auto device : Devices())
+        device->Reset();
+    }
+    else {
+      auto cit = commands.find(verb);
+      if (cit != commands.end()) {
+        cit->second(args);
+      }
+      else
+        UI::Error("Unknown command '%s'", verb.c_str());
+    }
+  }
 }
 
-void Controller::PauseTimer()
+std::set<std::shared_ptr<DeviceBase>> Controller::Devices() const
 {
-  if (sigprocmask(SIG_BLOCK, &sigmask_timer, NULL) == -1)
-    throw std::runtime_error("sigprocmask");
+  if (ui_inx < uis.size())
+    return uis[ui_inx]->Devices();
+  return {};
 }
 
-void Controller::ResumeTimer()
+void Controller::AddBackgroundDevice(std::shared_ptr<DeviceBase> device)
 {
-  if (sigprocmask(SIG_UNBLOCK, &sigmask_timer, NULL) == -1)
-    throw std::runtime_error("sigprocmask");
+  background_devices.insert(device);
+  reschedule = true;
 }
 
 void Controller::AddCommand(const std::string &verb, std::function<void(const std::string&)> f)
@@ -506,7 +590,7 @@ void Controller::Update(bool full)
 
 void Controller::Reconstruct()
 {
-  const std::lock_guard<std::mutex> lock(threads_mtx);
+  pool->Wait();
 
   for (auto &ui : uis)
     ui->Reconstruct();
@@ -6,17 +6,22 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <functional>
 #include <set>
 #include <thread>
 #include <mutex>
+#include <atomic>
+
+#include <signal.h>
 
 #include "device.h"
 
 class Decoder;
 class Encoder;
 class UI;
-class UpdateThread;
+class UpdatePool;
+class Scheduler;
 
 class Controller {
 public:
@@ -35,13 +40,22 @@ public:
   bool SelectSystem(size_t inx);
   void Run();
   void Stop();
+  void Wake();
 
   bool Running() const { return running; }
+  uint64_t Overruns() const;
 
   void AddBackgroundDevice(std::shared_ptr<DeviceBase> device);
 
   void AddCommand(const std::string &verb, std::function<void(const std::string&)> f);
 
+  void OnSignal(std::function<void(int)> f);
+
+  // Accept commands (one per line, as after ':') on a local stream socket.
+  void Listen(const std::string &path);
+
+  void Execute(const std::string &cmd);
+
   void Update(bool full);
 
   void Reconstruct();
@@ -50,9 +64,7 @@ public:
   void PreviousUI();
 
 protected:
-  bool running;
-  size_t cur_frequent_interval, cur_infrequent_interval;
-  double cur_frequency;
+  std::atomic<bool> running;
   size_t ui_inx, decoder_inx, encoder_inx;
   std::vector<std::shared_ptr<UI>> uis;
   std::vector<std::shared_ptr<Decoder>> decoders;
@@ -68,13 +80,25 @@ protected:
 
   std::map<const std::string, std::function<void(const std::string&)>> commands;
 
-  void PauseTimer();
-  void ResumeTimer();
-
-  std::mutex threads_mtx;
-  std::set<UpdateThread*> threads;
-
-  void ThreadCleanup();
+  int epoll_fd, timer_fd, signal_fd, event_fd, listen_fd;
+  std::string listen_path, stdin_buffer;
+  std::map<int, std::string> clients;
+  sigset_t signal_mask;
+  std::function<void(int)> on_signal;
+
+  std::unique_ptr<UpdatePool> pool;
+  std::unique_ptr<Scheduler> scheduler;
+  std::atomic<bool> reschedule;
+  uint64_t last_completed, last_overruns;
+
+  void ArmTimer(uint64_t deadline);
+  void HandleKey(int key);
+  void HandleSignals();
+  void AcceptClient();
+  void ReadCommands(int fd);
+  std::set<std::shared_ptr<DeviceBase>> Devices() const;
+  void Schedule(uint64_t now);
+  void ReportOverruns();
 };
 
 class BackgroundTask : public DeviceBase {
@@ -0,0 +1,93 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "integrity.h"
+#include "crc_tests.h"
+
+// The original bitwise implementations, as references.
+static uint8_t crc8_ref(const uint8_t *data, size_t size, uint8_t polynomial)
+{
+  uint8_t rem = 0;
+  for (size_t i = 0; i < size; i++) {
+    rem ^= data[i];
+    for (size_t j = 0; j < 8; j++)
+      rem = (rem & 0x80) ? (rem << 1) ^ polynomial : (rem << 1);
+  }
+  return rem;
+}
+
+static uint16_t crc16_ref(const uint8_t *data, size_t size, uint16_t polynomial, uint16_t init, uint16_t xorout)
+{
+  uint16_t rem = init;
+  for (size_t i = 0; i < size; i++) {
+    rem ^= data[i] << 8;
+    for (size_t j = 0; j < 8; j++)
+      rem = (rem & 0x8000) ? (rem << 1) ^ polynomial : (rem << 1);
+  }
+  return rem ^ xorout;
+}
+
+#define CHECK(C, ...) { if (!(C)) { printf("Failed: "); printf(__VA_ARGS__); printf("\n"); r = 1; } }
+
+template <typename C>
+static int check_variants(const char *name, const std::vector<uint8_t> &data)
+{
+  int r = 0;
+  auto bw = C::Bytewise(0, data.data(), data.size());
+  auto s4 = C::template Sliced<4>(0, data.data(), data.size());
+  auto s8 = C::template Sliced<8>(0, data.data(), data.size());
+  CHECK(bw == s4 && bw == s8, "%s slicing mismatch at size %zu", name, data.size());
+  return r;
+}
+
+int crc_tests(int argc, const char **argv)
+{
+  int r = 0;
+  const uint8_t check[] = "123456789";
+
+  // Catalogue check values.
+  CHECK(CRC8::Compute(check, 9) == 0xF4, "CRC-8");
+  CHECK(CRC16_CCITT::Compute(check, 9) == 0x29B1, "CRC-16/CCITT-FALSE");
+  CHECK((CRC<uint16_t, 0x1021>::Compute(check, 9)) == 0x31C3, "CRC-16/XMODEM");
+  CHECK((CRC<uint16_t, 0x8005, 0, true, true>::Compute(check, 9)) == 0xBB3D, "CRC-16/ARC");
+  CHECK(CRC32::Compute(check, 9) == 0xCBF43926, "CRC-32");
+  CHECK((CRC<uint32_t, 0x1EDC6F41, 0xFFFFFFFF, true, true, 0xFFFFFFFF>::Compute(check, 9)) == 0xE3069283, "CRC-32C");
+
+  std::mt19937 rng(42);
+  for (size_t size = 0; size < 300; size++) {
+    std::vector<uint8_t> data(size);
+    for (auto &b : data)
+      b = rng();
+
+    // crc8 as used by EnOcean frames, radio-test packets and the crc8 command.
+    CHECK(crc8(data) == crc8_ref(data.data(), size, 0x07), "crc8 at size %zu", size);
+    CHECK(crc8(data.data(), size, 0x31) == crc8_ref(data.data(), size, 0x31), "crc8/0x31 at size %zu", size);
+    if (size > 0) {
+      CHECK(crc8(data, 0x07, true) == crc8_ref(data.data(), size - 1, 0x07), "crc8 skip_last at size %zu", size);
+      std::vector<uint8_t> framed = data;
+      framed.push_back(crc8(data));
+      CHECK(crc8(framed, 0x07, true) == framed.back(), "crc8 frame check at size %zu", size);
+    }
+    if (size >= 10)
+      CHECK(crc8(data.data(), 10, 0x07) == crc8_ref(data.data(), 10, 0x07), "crc8 prefix");
+
+    for (uint16_t poly : { 0x1021, 0x8005, 0x3D65 })
+      for (uint16_t init : { 0x0000, 0xFFFF })
+        CHECK(crc16(data, poly, init, 0xFFFF) == crc16_ref(data.data(), size, poly, init, 0xFFFF),
+              "crc16/%04x/%04x at size %zu", poly, init, size);
+
+    r |= check_variants<CRC8>("CRC-8", data);
+    r |= check_variants<CRC16_CCITT>("CRC-16", data);
+    r |= check_variants<CRC32>("CRC-32", data);
+  }
+
+  std::cout << "crc   : " << (r == 0 ? "ok" : "failed") << std::endl;
+
+  return r;
+}
@@ -0,0 +1,9 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _CRC_TESTS_H_
+#define _CRC_TESTS_H_
+
+int crc_tests(int argc, const char **argv);
+
+#endif
@@ -5,6 +5,7 @@
 #define _DEVICE_H_
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "register.h"
@@ -18,10 +19,18 @@ public:
   virtual const char* Name() const = 0;
 
   virtual void UpdateTimed() {}
-  virtual double TimerFrequency() const { return 0; }
   virtual void UpdateFrequent() {}
   virtual void UpdateInfrequent() {}
 
+  // Update rates requested by the device; 0 means the controller's default.
+  virtual double TimerFrequency() const { return 0; } /* Hz */
+  virtual double FrequentPeriod() const { return 0; } /* s */
+  virtual double InfrequentPeriod() const { return 0; } /* s */
+
+  // The bus the device is attached to. Updates of devices on the same bus run
+  // one after the other; "" means the device doesn't share a bus.
+  virtual std::string Bus() const { return ""; }
+
   virtual void Write(std::ostream &os) const = 0;
   virtual void Read(std::istream &is) = 0;
 
@@ -28,8 +28,7 @@ ES9018K2M::RegisterTableSet::~RegisterTableSet()
 
 void ES9018K2M::RegisterTableSet::MainRT::Refresh(bool frequent)
 {
-  for (auto reg : registers)
-    buffer[reg->Address()] = device.I2CDevice::Read(reg->Address());
+  RefreshBursts(BurstPlan());
 }
 
 void ES9018K2M::RegisterTableSet::MainRT::Write(std::ostream &os) const
@@ -69,14 +68,13 @@ void ES9018K2M::RegisterTableSet::MainRT::Read(std::istream &is)
     std::string sval = e.value().get<std::string>();
     bool found = false;
 
-    for (const auto reg : registers)
-      if (reg->Name() == e.key()) {
-        uint8_t val;
-        sscanf(sval.c_str(), "%02hhx", &val);
-        device.I2CDevice::Write(reg->Address(), val);
-        found = true;
-        break;
-      }
+    auto reg = Find(e.key());
+    if (reg) {
+      uint8_t val;
+      sscanf(sval.c_str(), "%02hhx", &val);
+      device.I2CDevice::Write(reg->Address(), val);
+      found = true;
+    }
 
     if (!found)
       throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
@@ -85,14 +83,12 @@ void ES9018K2M::RegisterTableSet::MainRT::Read(std::istream &is)
 
 void ES9018K2M::RegisterTableSet::ConsumerRT::Refresh(bool frequent)
 {
-  for (auto reg : registers)
-    buffer[reg->Address()] = device.I2CDevice::Read(reg->Address());
+  RefreshBursts(BurstPlan());
 }
 
 void ES9018K2M::RegisterTableSet::ProfessionalRT::Refresh(bool frequent)
 {
-  for (auto reg : registers)
-    buffer[reg->Address()] = device.I2CDevice::Read(reg->Address());
+  RefreshBursts(BurstPlan());
 }
 
 void ES9018K2M::RegisterTableSet::Refresh(bool frequent)
@@ -10,36 +10,63 @@
 #include <vector>
 #include <algorithm>
 
+#include "bitstream.h"
 #include "evohome.h"
 
 Evohome::Decoder::Decoder() : ::Decoder() {}
 
 Evohome::Decoder::~Decoder() {}
 
-// Bytes are flanked by start/stop bits and reversed.
-static int get_frbyte(const std::vector<uint8_t> &buf, size_t pos, uint8_t *out)
-{
-  size_t end = buf.size() * 8;
-
-  if (pos < 0 || pos >= end)
-    return 0;
-
-  *out = 0;
+// Lookup tables for the over-the-air byte format: each byte is flanked by
+// start/stop bits and sent LSB first; payload nibbles are also Manchester-
+// encoded. Indices are the 8 data bits in the order they were received
+// (first bit in the MSB).
+struct EvohomeTables {
+  uint8_t reversed[256];
+  uint8_t nibble[256]; // Manchester-decoded nibble, 0xFF if a bit pair doesn't flip
+  uint8_t fm[16];      // Manchester-encoded nibble, as sent
+
+  constexpr EvohomeTables() : reversed(), nibble(), fm()
+  {
+    for (unsigned d = 0; d < 256; d++) {
+      uint8_t r = 0, n = 0;
+      bool valid = true;
+      for (unsigned i = 0; i < 8; i++)
+        r |= ((d >> i) & 0x01) << (7 - i);
+      reversed[d] = r;
+      for (unsigned j = 0; j < 4; j++) {
+        uint8_t b0 = (d >> (2*j + 1)) & 0x01, b1 = (d >> (2*j)) & 0x01;
+        valid = valid && b0 != b1;
+        n |= b0 << (3 - j);
+      }
+      nibble[d] = valid ? n : 0xFF;
+    }
+    for (unsigned n = 0; n < 16; n++) {
+      uint8_t d = 0;
+      for (unsigned j = 0; j < 4; j++) {
+        uint8_t v = (n >> j) & 0x01;
+        d |= (v << (7 - 2*j)) | ((v ^ 0x01) << (6 - 2*j));
+      }
+      fm[n] = d;
+    }
+  }
+};
 
-  if (pos >= end ||
-    get_bit(buf, pos++) != 0 ||
-    pos + 8 >= end)
-    return 0;
+static constexpr EvohomeTables tables;
 
-  for (unsigned i = 0; i < 8; i++)
-    *out = *out | (get_bit(buf, pos++) << i);
+// Reads the 8 data bits of the next flanked byte, in the order received.
+static bool get_fbits(BitReader &br, uint8_t *out)
+{
+  if (br.Remaining() <= 10)
+    return false;
 
-  if (pos >= end ||
-    get_bit(buf, pos++) != 1 ||
-    pos >= end)
-    return 0;
+  uint32_t s = br.Peek(10);
+  if ((s & 0x200) != 0 || (s & 0x001) != 1)
+    return false;
 
-  return 10;
+  *out = (s >> 1) & 0xFF;
+  br.Skip(10);
+  return true;
 }
 
 typedef struct { uint8_t t; const char s[4]; } dev_map_entry_t;
@@ -238,7 +265,7 @@ void Evohome::State::Update(const std::vector<uint8_t> &msg)
 const std::string& Evohome::Decoder::Decode(std::vector<uint8_t> &bytes)
 {
   size_t num_bytes = bytes.size();
-  size_t bpos = 0;
+  BitReader br(bytes);
 
 #define FAIL_IF(C,M) { if (C) { throw std::runtime_error(M); } }
 #define FAIL_IF_EXT(C,R) { if (C) { R; throw std::runtime_error(tmp); } }
@@ -246,19 +273,19 @@ const std::string& Evohome::Decoder::Decode(std::vector<uint8_t> &bytes)
   FAIL_IF(num_bytes == 0, "no bytes");
 
   // skip 01, last bits of preamble
-  while (get_bit(bytes, bpos) == 0 && bpos < bytes.size())
-    bpos++;
-  FAIL_IF(get_bit(bytes, bpos++) != 1, "Leading 1 missing.");
+  while (br.Remaining() > 0 && br.Peek(1) == 0)
+    br.Skip(1);
+  FAIL_IF(!br.ReadBit(), "Leading 1 missing.");
 
-  // skip Manchester-breaking header
+  // skip Manchester-breaking header; bytes are flanked by start/stop bits
+  // and reversed.
   uint8_t header[3] = { 0x33, 0x55, 0x53 };
-  uint8_t b;
+  uint8_t b, d;
   for (size_t i=0; i < 3; i++) {
-    int r = get_frbyte(bytes, bpos, &b);
-    FAIL_IF_EXT(r != 10, {
+    FAIL_IF_EXT(!get_fbits(br, &d), {
       snprintf(tmp, sizeof(tmp), "Could not read header byte %zd.", i);
     });
-    bpos += r;
+    b = tables.reversed[d];
     FAIL_IF_EXT(b != header[i], {
       snprintf(tmp, sizeof(tmp), "header[%zd] %02x != %02x mismatch.", i, b, header[i]);
     });
@@ -266,49 +293,31 @@ const std::string& Evohome::Decoder::Decode(std::vector<uint8_t> &bytes)
 
   // Find Footer 0x35 (0x55*)?
 
-  // read flanked and reversed bytes
-  size_t end = bytes.size() * 8;
-  size_t num_frbytes = 0;
-  while (bpos < end) {
-    if (get_frbyte(bytes, bpos, &b) != 10)
-      break;
-    bpos += 10;
-    bytes[num_frbytes++] = b;
-  }
-  bytes.resize(num_frbytes);
-
-  // Manchester decode
+  // Read flanked, reversed and Manchester-encoded bytes, two nibbles (20
+  // bits) at a time, until a symbol breaks either format. (Footer begins
+  // with 0x35 which breaks Manchester.) Decoded bytes are written back in
+  // place, behind the read position.
   size_t decoded = 0;
   uint8_t crc = 0;
-  b = 0;
-  if (num_frbytes % 2) num_frbytes--;
-  for (size_t i=0; i < num_frbytes; i++) {
-    for (size_t j=0; j < 8; j+=2) {
-      size_t binx = i*8 + j;
-      FAIL_IF(binx > num_frbytes*8, "Not enough data");
-
-      uint8_t b0 = get_bit(bytes, binx);
-      uint8_t b1 = get_bit(bytes, binx + 1);
-      if (b0 == b1) {
-        // Manchester-breaking byte means we must have reached the end.
-        // (Footer begins with 0x35 which breaks Manchester.)
-        goto man_end;
-      }
-      b = (b << 1) | b1;
-    }
-    if (i % 2 == 1) {
-      bytes[decoded++] = b;
-      crc += b;
-      b = 0;
-    }
+  while (br.Remaining() > 20) {
+    uint32_t s = br.Peek(20);
+    if ((s & 0x80200) != 0 || (s & 0x00401) != 0x00401)
+      break;
+    uint8_t h = tables.nibble[(s >> 11) & 0xFF], l = tables.nibble[(s >> 1) & 0xFF];
+    if (h == 0xFF || l == 0xFF)
+      break;
+    b = (h << 4) | l;
+    bytes[decoded++] = b;
+    crc += b;
+    br.Skip(20);
   }
-  man_end:
 
   if (crc != 0)
     throw std::runtime_error("CRC failed.");
 
-  if (decoded == 0)
-    throw std::runtime_error("Unknown decoder error.");
+  FAIL_IF_EXT(decoded == 0, {
+    snprintf(tmp, sizeof(tmp), "Invalid symbol at bit %zd.", br.Position());
+  });
 
   bytes.resize(decoded - 1);
   state.Update(bytes);
@@ -320,51 +329,16 @@ const std::string& Evohome::Decoder::Decode(std::vector<uint8_t> &bytes)
   return message.str;
 }
 
-static size_t add_bit(std::vector<uint8_t> &buf, size_t bpos, bool val)
-{
-  size_t byte_inx = bpos / 8;
-  if (byte_inx >= buf.size())
-    buf.resize(byte_inx + 1, 0);
-  uint8_t &byte = buf[byte_inx];
-  size_t bit_inx = bpos % 8;
-  byte = val ? (byte | (0x01 << (8 - bit_inx - 1)))
-             : (byte & ~(0x01 << (8 - bit_inx - 1)));
-  return bpos + 1;
-}
-
-static size_t add_byte(std::vector<uint8_t> &buf, size_t bpos, uint8_t val)
-{
-  for (size_t i=0; i < 8; i++)
-    bpos = add_bit(buf, bpos, (0x01ul << (8 - i - 1)));
-  return bpos;
-}
-
-static size_t add_fmnibble(std::vector<uint8_t> &buf, size_t bpos, uint8_t val)
-{
-  bpos = add_bit(buf, bpos, false);
-  for (size_t j=0; j < 4; j++) {
-    bool v = (val & (0x01 << j)) != 0;
-    bpos = add_bit(buf, bpos, v);
-    bpos = add_bit(buf, bpos, !v);
-  }
-  return add_bit(buf, bpos, true);
-}
-
-static size_t add_fmbyte(std::vector<uint8_t> &buf, size_t bpos, uint8_t val, uint8_t *sum)
+static void add_fmbyte(BitWriter &bw, uint8_t val, uint8_t *sum)
 {
   if (sum) *sum += val;
-  bpos = add_fmnibble(buf, bpos, val >> 4);
-  return add_fmnibble(buf, bpos, val & 0x0F);
+  bw.Write((tables.fm[val >> 4] << 1) | 0x01, 10);
+  bw.Write((tables.fm[val & 0x0F] << 1) | 0x01, 10);
 }
 
-static size_t add_fbyte(std::vector<uint8_t> &buf, size_t bpos, uint8_t val)
+static void add_fbyte(BitWriter &bw, uint8_t val)
 {
-  bpos = add_bit(buf, bpos, false);
-  for (size_t j=0; j < 8; j++) {
-    bool v = (val & (0x01 << j)) != 0;
-    bpos = add_bit(buf, bpos, v);
-  }
-  return add_bit(buf, bpos, true);
+  bw.Write((tables.reversed[val] << 1) | 0x01, 10);
 }
 
 
@@ -375,28 +349,27 @@ Evohome::Encoder::~Encoder() {}
 std::vector<uint8_t> Evohome::Encoder::Encode(const std::vector<uint8_t> &data)
 {
   std::vector<uint8_t> buf;
-  size_t bpos = 0;
   uint8_t bsum = 0;
 
   buf.reserve(1024);
+  BitWriter bw(buf);
 
   // End of preamble/sync word
-  bpos = add_bit(buf, bpos, false);
-  bpos = add_bit(buf, bpos, false);
-  bpos = add_bit(buf, bpos, true);
+  bw.Write(0b001, 3);
 
   uint8_t header[3] = { 0x33, 0x55, 0x53 };
   for (auto b : header)
-    bpos = add_fbyte(buf, bpos, b);
+    add_fbyte(bw, b);
 
   for (auto b : data)
-    bpos = add_fmbyte(buf, bpos, b, &bsum);
+    add_fmbyte(bw, b, &bsum);
 
-  bpos = add_fmbyte(buf, bpos, -bsum, &bsum);
+  add_fmbyte(bw, -bsum, &bsum);
 
   uint8_t footer[3] = { 0x35, 0x55, 0x55 };
   for (auto b : footer)
-    bpos = add_fbyte(buf, bpos, b);
+    add_fbyte(bw, b);
 
+  bw.Flush();
   return buf;
 }
@@ -7,6 +7,8 @@
 #include <memory>
 
 #include <errno.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include <gpiod.h>
 
@@ -24,6 +26,10 @@ public:
   {
     struct timespec timeout = { .tv_sec = 0, .tv_nsec = 250000000 };
     thread = new std::thread([this, chip, offset, consumer, timeout, rising_edge, active_low]() {
+      // Leave asynchronous signals to the controller thread.
+      sigset_t all;
+      sigfillset(&all);
+      pthread_sigmask(SIG_BLOCK, &all, NULL);
       if (gpiod_ctxless_event_monitor(chip, rising_edge ? GPIOD_CTXLESS_EVENT_RISING_EDGE :
                                                           GPIOD_CTXLESS_EVENT_FALLING_EDGE,
                                       offset, active_low,
@@ -6,95 +6,216 @@
 #include <string.h>
 
 #include <cstddef>
+#include <stdexcept>
 #include <vector>
 // #include <iostream>
-#include <unordered_set>
 
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
 #include "errors.h"
 #include "i2c_device.h"
 
-static std::unordered_set<std::string> busses;
+std::mutex I2CBus::registry_mtx;
+std::map<std::string, std::weak_ptr<I2CBus>> I2CBus::registry;
 
-I2CDeviceBase::I2CDeviceBase(const std::string &bus, uint8_t device_address) :
-  fd(-1),
-  bus(bus),
-  device_address(device_address)
-{
-}
-
-void I2CDeviceBase::Reset()
+std::shared_ptr<I2CBus> I2CBus::Get(const std::string &path)
 {
-  if (busses.find(bus) == busses.end()) {
+  const std::lock_guard<std::mutex> lock(registry_mtx);
+  std::shared_ptr<I2CBus> r = registry[path].lock();
+  if (!r) {
     // The first time we see a particular bus, we could issue a general command 0x06 (reset)?
-    busses.insert(bus);
-    // GeneralCall(0x06);
+    r = std::shared_ptr<I2CBus>(new I2CBus(path));
+    registry[path] = r;
   }
+  return r;
+}
 
-  const std::lock_guard<std::mutex> lock(mtx);
+I2CBus::I2CBus(const std::string &path) :
+  path(path),
+  fd(-1),
+  selected(-1),
+  next_ticket(0),
+  serving(0)
+{
+  if ((fd = open(path.c_str(), O_RDWR)) < 0)
+    throw_errno("failed to open the I2C bus");
+}
 
+I2CBus::~I2CBus()
+{
   if (fd >= 0)
     close(fd);
+}
 
-  if ((fd = open(bus.c_str(), O_RDWR)) < 0)
-    throw_errno("failed to open the I2C bus");
+void I2CBus::Acquire()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  uint64_t ticket = next_ticket++;
+  cv.wait(lock, [this, ticket]() { return serving == ticket; });
+}
 
-  if (ioctl(fd, I2C_SLAVE, device_address) < 0)
+void I2CBus::Release()
+{
+  {
+    const std::lock_guard<std::mutex> lock(mtx);
+    serving++;
+  }
+  cv.notify_all();
+}
+
+void I2CBus::Select(uint8_t address, bool force)
+{
+  if (!force && selected == address)
+    return;
+
+  selected = -1;
+  if (ioctl(fd, I2C_SLAVE, address) < 0)
     throw_errno("failed to acquire bus access and/or talk to slave");
+  selected = address;
 }
 
-void I2CDeviceBase::GeneralCall(uint8_t cmd)
+I2CBus::Lock::Lock(I2CBus &bus) :
+  bus(bus)
 {
-  const std::lock_guard<std::mutex> lock(mtx);
-  int fd;
+  bus.Acquire();
+}
 
-  if ((fd = open(bus.c_str(), O_RDWR)) < 0)
-    throw_errno("failed to open the I2C bus");
+I2CBus::Lock::Lock(I2CBus &bus, uint8_t address, bool force_select) :
+  bus(bus)
+{
+  bus.Acquire();
+  try {
+    bus.Select(address, force_select);
+  }
+  catch (...) {
+    bus.Release();
+    throw;
+  }
+}
+
+I2CBus::Lock::~Lock()
+{
+  bus.Release();
+}
+
+I2CDeviceBase::I2CDeviceBase(const std::string &bus, uint8_t device_address) :
+  bus(bus),
+  device_address(device_address)
+{
+}
+
+I2CBus& I2CDeviceBase::SharedBus()
+{
+  if (!i2c)
+    throw std::runtime_error("I2C bus not open");
+  return *i2c;
+}
+
+void I2CDeviceBase::Reset()
+{
+  if (!i2c)
+    i2c = I2CBus::Get(bus);
+
+  I2CBus::Lock lock(*i2c, device_address, true);
+}
+
+void I2CDeviceBase::GeneralCall(uint8_t cmd)
+{
+  if (!i2c)
+    i2c = I2CBus::Get(bus);
 
   // This reset all devices on the bus!
-  if (ioctl(fd, I2C_SLAVE, 0x00) < 0)
-    throw_errno("failed to acquire bus access and/or talk to slave");
+  I2CBus::Lock lock(*i2c, 0x00);
 
-  if (write(fd, &cmd, 1) != 1)
+  if (write(lock.fd(), &cmd, 1) != 1)
     throw_errno("failed to write to the I2C bus");
+}
+
+void I2CDeviceBase::Transfer(const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen)
+{
+  struct i2c_msg msgs[2];
+  struct i2c_rdwr_ioctl_data data;
+
+  data.msgs = msgs;
+  data.nmsgs = 0;
+
+  if (wlen > 0) {
+    msgs[data.nmsgs].addr = device_address;
+    msgs[data.nmsgs].flags = 0;
+    msgs[data.nmsgs].len = wlen;
+    msgs[data.nmsgs].buf = const_cast<uint8_t*>(wbuf);
+    data.nmsgs++;
+  }
+
+  if (rlen > 0) {
+    msgs[data.nmsgs].addr = device_address;
+    msgs[data.nmsgs].flags = I2C_M_RD;
+    msgs[data.nmsgs].len = rlen;
+    msgs[data.nmsgs].buf = rbuf;
+    data.nmsgs++;
+  }
 
-  close(fd);
+  if (data.nmsgs == 0)
+    return;
+
+  I2CBus::Lock lock(SharedBus());
+  if (ioctl(lock.fd(), I2C_RDWR, &data) < 0)
+    throw_errno("I2C transfer failed");
+}
+
+void I2CDeviceBase::WriteBlock(uint8_t addr, const uint8_t *buf, size_t len)
+{
+  // Register address and data have to go out in the same message.
+  uint8_t small[32];
+  std::vector<uint8_t> large;
+  uint8_t *wbuf = small;
+  if (len + 1 > sizeof(small)) {
+    large.resize(len + 1);
+    wbuf = large.data();
+  }
+  wbuf[0] = addr;
+  memcpy(wbuf + 1, buf, len);
+  Transfer(wbuf, len + 1, nullptr, 0);
 }
 
 template<>
 uint8_t I2CDevice<uint8_t, uint8_t>::Read(const uint8_t &addr)
 {
-  uint8_t buf = addr;
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, &buf, 1) != 1)
-    throw_errno("failed to write to the I2C bus");
-  if (read(fd, &buf, 1) != 1)
-    throw_errno("failed to read from the I2C bus");
+  uint8_t buf;
+  ReadBlock(addr, &buf, 1);
   // std::cout << " - " << std::hex << (unsigned)addr << " == " << std::hex << buf << " (" << fd << ")" << std::endl;
   return buf;
 }
 
+template<>
+std::vector<uint8_t> I2CDevice<uint8_t, uint8_t>::Read(const uint8_t &addr, size_t length)
+{
+  std::vector<uint8_t> r(length);
+  ReadBlock(addr, r.data(), length);
+  return r;
+}
+
 template<>
 void I2CDevice<uint8_t, uint8_t>::Write(const uint8_t &addr, const uint8_t &value)
 {
   // std::cout << " - " << std::hex << (unsigned)addr << " := " << value << " (" << fd << ")" << std::endl;
   uint8_t buf[2] = { addr, value };
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, buf, 2) != 2)
-    throw_errno("failed to write to the I2C bus");
+  Transfer(buf, 2, nullptr, 0);
+}
+
+template<>
+void I2CDevice<uint8_t, uint8_t>::Write(const uint8_t &addr, const std::vector<uint8_t> &values)
+{
+  WriteBlock(addr, values.data(), values.size());
 }
 
 template<>
 uint16_t I2CDevice<uint8_t, uint16_t>::Read(const uint8_t &addr)
 {
-  uint8_t buf[2] = { addr };
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, buf, 1) != 1)
-    throw_errno("failed to write to the I2C bus");
-  if (read(fd, buf, 2) != 2)
-    throw_errno("failed to read from the I2C bus");
+  uint8_t buf[2];
+  ReadBlock(addr, buf, 2);
   uint16_t r = buf[0] << 8 | buf[1];
   // std::cout << " - " << std::hex << (unsigned)addr << " == " << std::hex << r << " (" << fd << ")" << std::endl;
   return r;
@@ -108,18 +229,20 @@ void I2CDevice<uint8_t, uint16_t>::Write(const uint8_t &addr, const uint16_t &va
   buf[0] = addr;
   buf[1] = value >> 8;
   buf[2] = value & 0xFF;
-  std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, buf, 3) != 3)
-    throw_errno("failed to write to the I2C bus");
+  Transfer(buf, 3, nullptr, 0);
 }
 
 template<>
 std::vector<uint8_t> I2CDevice<uint8_t, std::vector<uint8_t>>::Read(const uint8_t &addr)
 {
-  return {};
+  // Without knowledge of the register width, read a single byte.
+  std::vector<uint8_t> r(1);
+  ReadBlock(addr, r.data(), r.size());
+  return r;
 }
 
 template <>
 void I2CDevice<uint8_t, std::vector<uint8_t>>::Write(const uint8_t &addr, const std::vector<uint8_t> &value)
 {
+  WriteBlock(addr, value.data(), value.size());
 }
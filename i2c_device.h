@@ -6,6 +6,9 @@
 
 #include <unistd.h>
 
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <cstddef>
 #include <vector>
@@ -13,26 +16,73 @@
 
 #include "device.h"
 
+// A bus device node (e.g. /dev/i2c-1), shared by all devices on that bus.
+// It owns the only fd for the bus, issues I2C_SLAVE only when the selected
+// address changes, and grants access in the order it was requested.
+class I2CBus {
+public:
+  static std::shared_ptr<I2CBus> Get(const std::string &path);
+
+  virtual ~I2CBus();
+
+  const std::string& Path() const { return path; }
+
+  class Lock {
+  public:
+    Lock(I2CBus &bus);
+    Lock(I2CBus &bus, uint8_t address, bool force_select = false);
+    virtual ~Lock();
+
+    int fd() const { return bus.fd; }
+
+  protected:
+    I2CBus &bus;
+  };
+
+protected:
+  I2CBus(const std::string &path);
+
+  std::string path;
+  int fd;
+  int selected;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  uint64_t next_ticket, serving;
+
+  void Acquire();
+  void Release();
+  void Select(uint8_t address, bool force);
+
+  static std::mutex registry_mtx;
+  static std::map<std::string, std::weak_ptr<I2CBus>> registry;
+};
+
 class I2CDeviceBase {
 public:
   I2CDeviceBase(const std::string &bus, uint8_t device_address);
 
-  I2CDeviceBase() : fd(-1), bus(""), device_address(0x00) {}
+  I2CDeviceBase() : bus(""), device_address(0x00) {}
 
-  virtual ~I2CDeviceBase() {
-    if (fd >= 0)
-      close(fd);
-  }
+  virtual ~I2CDeviceBase() {}
 
   virtual void Reset();
 
   virtual void GeneralCall(uint8_t);
 
 protected:
-  mutable std::mutex mtx;
-  int fd;
+  std::shared_ptr<I2CBus> i2c;
   std::string bus;
   uint8_t device_address;
+
+  I2CBus& SharedBus();
+
+  // Writes `wlen` bytes and then, after a repeated start, reads `rlen` bytes,
+  // all in one I2C_RDWR ioctl.
+  void Transfer(const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen);
+
+  void ReadBlock(uint8_t addr, uint8_t *buf, size_t len) { Transfer(&addr, 1, buf, len); }
+  void WriteBlock(uint8_t addr, const uint8_t *buf, size_t len);
 };
 
 template <typename AT, typename VT>
@@ -46,7 +96,7 @@ public:
 
   virtual ~I2CDevice() = default;
 
-  std::string Bus() const { return bus; }
+  virtual std::string Bus() const override { return bus; }
   uint8_t DeviceAddress() const { return device_address; }
 
   using I2CDeviceBase::Reset;
@@ -73,10 +123,19 @@ public:
   }
 
 protected:
-  using I2CDeviceBase::mtx;
-  using I2CDeviceBase::fd;
+  using I2CDeviceBase::i2c;
   using I2CDeviceBase::bus;
   using I2CDeviceBase::device_address;
+  using I2CDeviceBase::Transfer;
+  using I2CDeviceBase::ReadBlock;
+  using I2CDeviceBase::WriteBlock;
+  using I2CDeviceBase::SharedBus;
 };
 
+// Block transfers for devices with auto-incrementing register addresses. The
+// 16-bit register devices (INA219, MCP9808) don't auto-increment and keep
+// reading one register at a time.
+template<> std::vector<uint8_t> I2CDevice<uint8_t, uint8_t>::Read(const uint8_t &addr, size_t length);
+template<> void I2CDevice<uint8_t, uint8_t>::Write(const uint8_t &addr, const std::vector<uint8_t> &values);
+
 #endif // _I2C_DEVICE_H_
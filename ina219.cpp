@@ -190,14 +190,13 @@ void INA219::RegisterTable::Read(std::istream &is)
     std::string sval = e.value().get<std::string>();
     bool found = false;
 
-    for (const auto reg : registers)
-      if (reg->Name() == e.key()) {
-        uint16_t val;
-        sscanf(sval.c_str(), "%04hx", &val);
-        device.Write(*reg, val);
-        found = true;
-        break;
-      }
+    auto reg = Find(e.key());
+    if (reg) {
+      uint16_t val;
+      sscanf(sval.c_str(), "%04hx", &val);
+      device.Write(*reg, val);
+      found = true;
+    }
     if (!found)
       throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
   }
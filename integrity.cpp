@@ -10,13 +10,11 @@ uint8_t crc8(const std::vector<uint8_t> &data, uint8_t polynomial, bool skip_las
   return crc8(data.data(), data.size(), polynomial, skip_last);
 }
 
-uint8_t crc8(const uint8_t *data, size_t size, uint8_t polynomial, bool skip_last)
+// Bitwise fallbacks for polynomials without a table.
+static uint8_t crc8_bitwise(const uint8_t *data, size_t size, uint8_t polynomial)
 {
   uint8_t rem = 0;
 
-  if (skip_last)
-    size--;
-
   for (size_t i = 0; i < size; i++)
   {
     rem = rem ^ data[i];
@@ -32,12 +30,7 @@ uint8_t crc8(const uint8_t *data, size_t size, uint8_t polynomial, bool skip_las
   return rem;
 }
 
-uint16_t crc16(const std::vector<uint8_t> &data, uint16_t polynomial, uint16_t init, uint16_t xorout, bool skip_last)
-{
-  return crc16(data.data(), data.size(), polynomial, init, xorout, skip_last);
-}
-
-uint16_t crc16(const uint8_t *data, size_t size, uint16_t polynomial, uint16_t init, uint16_t xorout, bool skip_last)
+static uint16_t crc16_bitwise(const uint8_t *data, size_t size, uint16_t polynomial, uint16_t init)
 {
   uint16_t rem = init;
 
@@ -54,6 +47,35 @@ uint16_t crc16(const uint8_t *data, size_t size, uint16_t polynomial, uint16_t i
     }
   }
 
+  return rem;
+}
+
+uint8_t crc8(const uint8_t *data, size_t size, uint8_t polynomial, bool skip_last)
+{
+  if (skip_last)
+    size--;
+
+  if (polynomial == 0x07)
+    return CRC8::Compute(data, size);
+  else
+    return crc8_bitwise(data, size, polynomial);
+}
+
+uint16_t crc16(const std::vector<uint8_t> &data, uint16_t polynomial, uint16_t init, uint16_t xorout, bool skip_last)
+{
+  return crc16(data.data(), data.size(), polynomial, init, xorout, skip_last);
+}
+
+uint16_t crc16(const uint8_t *data, size_t size, uint16_t polynomial, uint16_t init, uint16_t xorout, bool skip_last)
+{
+  uint16_t rem;
+
+  switch (polynomial) {
+    case 0x1021: rem = CRC<uint16_t, 0x1021>::Update(init, data, size); break;
+    case 0x8005: rem = CRC<uint16_t, 0x8005>::Update(init, data, size); break;
+    default: rem = crc16_bitwise(data, size, polynomial, init);
+  }
+
   return rem ^ xorout;
 }
 
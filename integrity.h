@@ -4,9 +4,111 @@
 #ifndef _INTEGRITY_H_
 #define _INTEGRITY_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+// Table-driven CRC over registers of width 8*sizeof(T), with the usual
+// catalogue parameters; Init is given unreflected. Update works on the raw
+// register (reflected if RefIn), Compute does the whole thing. Buffers of
+// 32 bytes or more are processed 8 bytes at a time (slicing-by-8). There is
+// no carry-less multiply (PCLMUL) folding path: the frames checked here are
+// far too short for it to beat the tables.
+template <typename T, T Poly, T Init = 0, bool RefIn = false, bool RefOut = false, T XorOut = 0>
+class CRC {
+public:
+  static constexpr unsigned width = 8 * sizeof(T);
+
+  static constexpr T Reflect(T x)
+  {
+    T r = 0;
+    for (unsigned i = 0; i < width; i++)
+      r |= ((x >> i) & 0x01) << (width - 1 - i);
+    return r;
+  }
+
+  // t[k][b] is the register after byte b and k zero bytes, starting from 0.
+  struct Tables {
+    T t[8][256];
+
+    constexpr Tables() : t()
+    {
+      constexpr T top = (T)1 << (width - 1);
+      constexpr T rpoly = Reflect(Poly);
+      for (unsigned b = 0; b < 256; b++) {
+        T r = RefIn ? (T)b : (T)((T)b << (width - 8));
+        for (unsigned j = 0; j < 8; j++)
+          if (RefIn)
+            r = (r & 0x01) ? (T)((r >> 1) ^ rpoly) : (T)(r >> 1);
+          else
+            r = (r & top) ? (T)((T)(r << 1) ^ Poly) : (T)(r << 1);
+        t[0][b] = r;
+      }
+      for (unsigned k = 1; k < 8; k++)
+        for (unsigned b = 0; b < 256; b++)
+          t[k][b] = Step(t[k-1][b], 0, t[0]);
+    }
+  };
+
+  static const Tables tables;
+
+  static T Bytewise(T reg, const uint8_t *data, size_t size)
+  {
+    for (size_t i = 0; i < size; i++)
+      reg = Step(reg, data[i], tables.t[0]);
+    return reg;
+  }
+
+  template <size_t N>
+  static T Sliced(T reg, const uint8_t *data, size_t size)
+  {
+    static_assert(N >= sizeof(T) && N <= 8, "unsupported slice width");
+    for (; size >= N; data += N, size -= N) {
+      uint8_t d[N];
+      for (size_t i = 0; i < N; i++)
+        d[i] = data[i];
+      for (size_t i = 0; i < sizeof(T); i++)
+        d[i] ^= RefIn ? reg >> (8 * i) : reg >> (width - 8 * (i + 1));
+      reg = 0;
+      for (size_t i = 0; i < N; i++)
+        reg ^= tables.t[N - 1 - i][d[i]];
+    }
+    return Bytewise(reg, data, size);
+  }
+
+  static T Update(T reg, const uint8_t *data, size_t size)
+  {
+    return size >= 32 ? Sliced<8>(reg, data, size) : Bytewise(reg, data, size);
+  }
+
+  static T Compute(const uint8_t *data, size_t size)
+  {
+    T reg = Update(RefIn ? Reflect(Init) : Init, data, size);
+    return (RefIn != RefOut ? Reflect(reg) : reg) ^ XorOut;
+  }
+
+  static T Compute(const std::vector<uint8_t> &data)
+  {
+    return Compute(data.data(), data.size());
+  }
+
+protected:
+  static constexpr T Step(T reg, uint8_t byte, const T *t0)
+  {
+    if (RefIn)
+      return (width > 8 ? (T)(reg >> 8) : 0) ^ t0[(reg ^ byte) & 0xFF];
+    else
+      return (width > 8 ? (T)(reg << 8) : 0) ^ t0[((reg >> (width - 8)) ^ byte) & 0xFF];
+  }
+};
+
+template <typename T, T Poly, T Init, bool RefIn, bool RefOut, T XorOut>
+constexpr typename CRC<T, Poly, Init, RefIn, RefOut, XorOut>::Tables CRC<T, Poly, Init, RefIn, RefOut, XorOut>::tables;
+
+typedef CRC<uint8_t, 0x07> CRC8;
+typedef CRC<uint16_t, 0x1021, 0xFFFF> CRC16_CCITT;
+typedef CRC<uint32_t, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF> CRC32;
+
 uint8_t crc8(const std::vector<uint8_t> &data, uint8_t polynomial = 0x07, bool skip_last = false);
 uint8_t crc8(const uint8_t *data, size_t size, uint8_t polynomial = 0x07, bool skip_last = false);
 
@@ -47,8 +47,8 @@ const std::vector<double>& MCP3423::Readings()
 
 void MCP3423::Write(const uint8_t &config)
 {
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (write(fd, &config, 1) != 1)
+  I2CBus::Lock lock(SharedBus(), device_address);
+  if (write(lock.fd(), &config, 1) != 1)
     throw_errno("failed to write to the I2C bus");
 }
 
@@ -71,8 +71,8 @@ uint8_t MCP3423::Read(const uint8_t &addr)
   if (addr != 0)
     throw std::logic_error("device registers not addressable");
   uint8_t buf[4];
-  const std::lock_guard<std::mutex> lock(mtx);
-  if (read(fd, &buf[0], 4) != 4)
+  I2CBus::Lock lock(SharedBus(), device_address);
+  if (read(lock.fd(), &buf[0], 4) != 4)
     throw_errno("failed to read from the I2C bus");
   int32_t val = 0;
   uint8_t config = buf[3];
@@ -178,14 +178,13 @@ void MCP3423::RegisterTable::Read(std::istream &is)
     std::string sval = e.value().get<std::string>();
     bool found = false;
 
-    for (const auto reg : registers)
-      if (reg->Name() == e.key()) {
-        uint8_t val;
-        sscanf(sval.c_str(), "%02hhx", &val);
-        device.Write(reg->Address(), val);
-        found = true;
-        break;
-      }
+    auto reg = Find(e.key());
+    if (reg) {
+      uint8_t val;
+      sscanf(sval.c_str(), "%02hhx", &val);
+      device.Write(reg->Address(), val);
+      found = true;
+    }
     if (!found)
       throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
   }
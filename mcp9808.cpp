@@ -114,15 +114,11 @@ void MCP9808::RegisterTable::Read(std::istream &is)
       device.Write(device.RT._rResolution_.Address(), val);
       found = true;
     }
-    else {
-      for (const auto reg : registers)
-        if (reg->Name() == e.key()) {
-          uint16_t val;
-          sscanf(sval.c_str(), "%04hx", &val);
-          device.Write(reg->Address(), val);
-          found = true;
-          break;
-        }
+    else if (auto reg = Find(e.key())) {
+      uint16_t val;
+      sscanf(sval.c_str(), "%04hx", &val);
+      device.Write(reg->Address(), val);
+      found = true;
     }
     if (!found)
       throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
@@ -2,6 +2,8 @@
 // Licensed under the MIT License.
 
 #include <cstring>
+#include <memory>
+#include <stdexcept>
 
 #include <openssl/evp.h>
 
@@ -21,28 +23,32 @@ using json = nlohmann::json;
 
 // #define TEST_VERBOSE
 
-static int decrypt_openssl(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t* key, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag, uint8_t *plain_out)
-{
-  EVP_CIPHER_CTX *ctx;
-  if (!(ctx = EVP_CIPHER_CTX_new()) ||
-      !EVP_DecryptInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL) ||
-      !EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv))
-      return 1;
-
-  int len = 0;
-  if (!EVP_DecryptUpdate(ctx, NULL, &len, aad, aad_len))
-     return 1;
+// The key schedule is computed once, in the constructor; each message only
+// resets the IV.
+class Radbot::AESGCM {
+public:
+  AESGCM(const uint8_t *key) :
+    ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free)
+  {
+    if (!ctx || !EVP_DecryptInit_ex(ctx.get(), EVP_aes_128_gcm(), NULL, key, NULL))
+      throw std::runtime_error("AES-GCM initialization failed");
+  }
 
-  int plain_len = 0;
-  if(!EVP_DecryptUpdate(ctx, plain_out, &plain_len, cipher, cipher_len) ||
-     !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, (void*)auth_tag))
-    return 1;
+  int Decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag, uint8_t *plain_out)
+  {
+    int len = 0, plain_len = 0;
+    if (!EVP_DecryptInit_ex(ctx.get(), NULL, NULL, NULL, iv) ||
+        !EVP_DecryptUpdate(ctx.get(), NULL, &len, aad, aad_len) ||
+        !EVP_DecryptUpdate(ctx.get(), plain_out, &plain_len, cipher, cipher_len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, 16, (void*)auth_tag))
+      return 1;
 
-  int r = EVP_DecryptFinal_ex(ctx, plain_out + plain_len, &len);
-  EVP_CIPHER_CTX_free(ctx);
+    return EVP_DecryptFinal_ex(ctx.get(), plain_out + plain_len, &len) <= 0;
+  }
 
-  return r <= 0;
-}
+protected:
+  std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx;
+};
 
 #ifdef OTHER_CRYPTO
 static int decrypt_cryptopp(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t* key, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag, uint8_t *plain_out)
@@ -70,7 +76,7 @@ static int decrypt_cryptopp(const uint8_t* cipher, size_t cipher_len, const uint
 }
 #endif
 
-static int decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t* key, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag, uint8_t *plain_out)
+static int decrypt(Radbot::AESGCM &aes, const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag, uint8_t *plain_out)
 {
 #ifdef TEST_VERBOSE
   printf("cipher         : ");
@@ -79,9 +85,6 @@ static int decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv,
   printf("\niv             : ");
   for (size_t i=0; i < 12; i++)
     printf("%02x", iv[i]);
-  printf("\nkey            : ");
-  for (size_t i=0; i < 16; i++)
-    printf("%02x", key[i]);
   printf("\naad            : ");
   for (size_t i=0; i < aad_len; i++)
     printf("%02x", aad[i]);
@@ -91,7 +94,7 @@ static int decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv,
   printf("\n");
 #endif
 
-  int r = decrypt_openssl(cipher, cipher_len, iv, key, aad, aad_len, auth_tag, plain_out);
+  int r = aes.Decrypt(cipher, cipher_len, iv, aad, aad_len, auth_tag, plain_out);
 
 #ifdef TEST_VERBOSE
   printf("plain openssl  : ");
@@ -100,7 +103,13 @@ static int decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv,
   printf(" (%d)\n", r);
 #endif
 
+  return r;
+}
+
 #ifdef OTHER_CRYPTO
+// Decrypts again with Crypto++ and OTAESGCM, for comparison.
+static void decrypt_others(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv, const uint8_t* key, const uint8_t *aad, size_t aad_len, const uint8_t* auth_tag)
+{
   uint8_t plain2[cipher_len];
   int r2 = decrypt_cryptopp(cipher, cipher_len, iv, key, aad, aad_len, auth_tag, plain2);
 
@@ -122,10 +131,8 @@ static int decrypt(const uint8_t* cipher, size_t cipher_len, const uint8_t* iv,
     printf("%02x", plain3[i]);
   printf(" (%d)\n", r3);
 #endif
-#endif
-
-  return r;
 }
+#endif
 
 Radbot::State::State() :
   ::State(),
@@ -210,6 +217,7 @@ Radbot::Decoder::Decoder(const std::string &id, const std::string &key) : ::Deco
     sscanf(id.c_str() + (2*i), "%02hhx", &this->id[i]);
   for (size_t i=0; i < 16; i++)
     sscanf(key.c_str() + (2*i), "%02hhx", &this->key[i]);
+  aes = std::make_unique<AESGCM>(this->key);
 }
 
 Radbot::Decoder::~Decoder() {}
@@ -306,7 +314,10 @@ const std::string& Radbot::Decoder::Decode(std::vector<uint8_t> &bytes)
     FAIL_IF(frame_seq_num_m16 != (iv[11] & 0x0f), "frame sequence number mismatch");
 
     std::vector<uint8_t> msg(body_len, 0);
-    int rd = decrypt(body, body_len, iv, key, header, header_len, auth_tag, msg.data());
+    int rd = decrypt(*aes, body, body_len, iv, header, header_len, auth_tag, msg.data());
+#ifdef OTHER_CRYPTO
+    decrypt_others(body, body_len, iv, key, header, header_len, auth_tag);
+#endif
 
     FAIL_IF(rd != 0, "decryption failed");
 
@@ -356,6 +367,21 @@ const std::string& Radbot::Decoder::Decode(std::vector<uint8_t> &bytes)
   return tmp_str;
 }
 
+std::vector<std::string> Radbot::Decoder::DecodeBatch(std::vector<std::vector<uint8_t>> &frames)
+{
+  std::vector<std::string> r;
+  r.reserve(frames.size());
+  for (auto &frame : frames) {
+    try {
+      r.push_back(Decode(frame));
+    }
+    catch (const std::runtime_error &) {
+      r.push_back("");
+    }
+  }
+  return r;
+}
+
 Radbot::Encoder::Encoder(const std::string &id, const std::string &key) : ::Encoder() {
   for (size_t i=0; i < 8; i++)
     sscanf(id.c_str() + (2*i), "%02hhx", &this->id[i]);
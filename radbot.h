@@ -4,6 +4,7 @@
 #ifndef _RADBOT_H_
 #define _RADBOT_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -48,10 +49,14 @@ public:
     void virtual Update(const std::vector<uint8_t> &msg);
   };
 
+  // Pre-keyed AES-128-GCM decryption context.
+  class AESGCM;
+
   class Decoder : public ::Decoder {
   protected:
     uint8_t id[8], key[16];
     uint8_t iv[12];
+    std::unique_ptr<AESGCM> aes;
     char tmp[2048];
     std::string tmp_str;
 
@@ -62,6 +67,10 @@ public:
     virtual ~Decoder();
 
     virtual const std::string& Decode(std::vector<uint8_t> &bytes);
+
+    // Decodes all frames with the same cipher context; frames that fail to
+    // decode yield an empty string.
+    std::vector<std::string> DecodeBatch(std::vector<std::vector<uint8_t>> &frames);
   };
 
   class Encoder : public ::Encoder {
@@ -117,9 +117,9 @@ public:
     if (v_str_len == 0 || v_str_len > 2 || !Parse(v_str, v))
       UI::Error("Invalid value '%s'", v_str);
     else if (var != NULL)
-      rt.Device().Write(reg, var->Set(rt(reg), v));
+      rt.Write(reg, var->Set(rt(reg), v));
     else
-      rt.Device().Write(reg, v);
+      rt.Write(reg, v);
   }
 };
 
@@ -4,9 +4,11 @@
 #ifndef _REGISTER_H_
 #define _REGISTER_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <unordered_map>
 
 typedef struct {
   bool readable;
@@ -18,6 +20,29 @@ static const ReadWriteSpec RO = { .readable=true, .writeable=false };
 static const ReadWriteSpec RW = { .readable=true, .writeable=true };
 static const ReadWriteSpec WO = { .readable=false, .writeable=true };
 
+template <typename T>
+constexpr uint16_t mask_shift(T mask)
+{
+  uint16_t shift = 0;
+  while (mask != 0 && (mask & 1) == 0) {
+    mask >>= 1;
+    shift++;
+  }
+  return shift;
+}
+
+// A field mask known at compile time; Get() compiles to a mask and a shift.
+// The single template parameter keeps it usable inside macro arguments.
+template <auto M>
+struct ConstMask {
+  typedef decltype(M) T;
+  static_assert(M != 0, "invalid variable mask");
+  static constexpr T mask = M;
+  static constexpr uint16_t shift = mask_shift(M);
+  static constexpr T Get(const T &rv) { return (rv & mask) >> shift; }
+  static constexpr T Set(const T &rv, const T &vv) { return (rv & ~mask) | ((vv << shift) & mask); }
+};
+
 template <typename VT>
 class Variable
 {
@@ -92,13 +117,7 @@ inline std::vector<uint8_t> Variable<std::vector<uint8_t>>::operator()(const std
   {                                                               \
     if (mask == 0)                                                \
       throw std::runtime_error("invalid variable mask");          \
-    shift = 0;                                                    \
-    T tmp = mask;                                                 \
-    while (tmp % 2 == 0)                                          \
-    {                                                             \
-      shift++;                                                    \
-      tmp >>= 1;                                                  \
-    }                                                             \
+    shift = mask_shift(mask);                                     \
   }
 
 VARCONSTRUCTOR(uint8_t)
@@ -192,6 +211,7 @@ public:
 
 protected:
   Variables variables;
+  std::unordered_map<std::string, Variable<VT>*> variable_index;
 
 public:
   Register(const std::string &name,
@@ -203,17 +223,17 @@ public:
   {}
   virtual ~Register() {}
 
-  void Add(Variable<VT> *v) { variables.push_back(v); }
+  void Add(Variable<VT> *v) {
+    variables.push_back(v);
+    variable_index.emplace(v->Name(), v);
+  }
   const_iterator begin() const { return variables.begin(); }
   const_iterator end() const { return variables.end(); }
   size_t size() const { return variables.size(); }
   virtual size_t value_size() const { return sizeof(VT); }
-  Variable<VT>* find_variable(const char *name) {
-    for (auto *v : variables) {
-      if (v->Name() == name)
-        return v;
-    }
-    return nullptr;
+  Variable<VT>* find_variable(const std::string &name) {
+    auto it = variable_index.find(name);
+    return it != variable_index.end() ? it->second : nullptr;
   }
 };
 
@@ -4,14 +4,54 @@
 #ifndef _REGISTER_TABLE_H_
 #define _REGISTER_TABLE_H_
 
+#include <cstdint>
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "register.h"
 
 #define STR(S) #S
 
+// A read of `length` consecutive registers, starting at `address`.
+template <typename AT>
+struct BurstRead {
+  AT address;
+  size_t length;
+};
+
+// Merges the addresses of the readable registers that `include` accepts into
+// the smallest set of burst reads. Holes in the address space and registers
+// that are not included (e.g. FIFOs or registers that clear on read) split
+// bursts, and no burst is longer than `max_length`.
+template <typename AT, typename IT, typename P>
+std::vector<BurstRead<AT>> PlanBurstReads(IT begin, IT end, P include, size_t max_length = SIZE_MAX)
+{
+  std::vector<AT> addrs;
+  for (IT it = begin; it != end; it++)
+    if ((*it)->Readable() && include(**it))
+      addrs.push_back((*it)->Address());
+
+  std::sort(addrs.begin(), addrs.end());
+  addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+
+  std::vector<BurstRead<AT>> r;
+  for (const AT &a : addrs) {
+    if (!r.empty()) {
+      BurstRead<AT> &last = r.back();
+      if ((size_t)a == (size_t)last.address + last.length && last.length < max_length) {
+        last.length++;
+        continue;
+      }
+    }
+    r.push_back({a, 1});
+  }
+  return r;
+}
+
 class RegisterTableBase
 {
 public:
@@ -20,6 +60,31 @@ public:
   virtual void Initialize() = 0;
 };
 
+// Builds the lookup tables behind Find(): a dense address-to-register array
+// (for address spaces up to 64K) and a name hash map. Where registers share an
+// address or name, the first one wins, as with a linear search.
+template <typename R>
+void BuildIndexes(const std::vector<R*> &registers,
+                  std::vector<R*> &by_address,
+                  std::unordered_map<std::string, R*> &by_name)
+{
+  size_t max_address = 0;
+  for (auto r : registers)
+    max_address = std::max(max_address, (size_t)r->Address());
+
+  by_address.clear();
+  if (!registers.empty() && max_address < 0x10000) {
+    by_address.resize(max_address + 1, nullptr);
+    for (auto r : registers)
+      if (!by_address[r->Address()])
+        by_address[r->Address()] = r;
+  }
+
+  by_name.clear();
+  for (auto r : registers)
+    by_name.emplace(r->Name(), r);
+}
+
 template <typename AT, typename VT>
 class DenseBuffer : public std::vector<VT> {
 public:
@@ -104,6 +169,45 @@ protected:
   DEVICE &device;
   Registers registers;
   BT buffer;
+  std::vector<TRegister*> address_index;
+  std::unordered_map<std::string, TRegister*> name_index;
+  std::map<int, std::vector<BurstRead<AT>>> burst_plans;
+  std::mutex shadow_mtx;
+  std::map<AT, VT> staged;
+
+  const VT& Shadow(const AT &address) const {
+    auto it = staged.find(address);
+    return it != staged.end() ? it->second : buffer[address];
+  }
+
+  void StageLocked(const AT &address, const VT &value) {
+    if (buffer[address] == value)
+      staged.erase(address);
+    else
+      staged[address] = value;
+  }
+
+  // The burst reads for refresh class `cls`, planned on first use. Plans
+  // are cached, so `include` must not change between calls.
+  template <typename P>
+  const std::vector<BurstRead<AT>>& BurstPlan(int cls, P include, size_t max_length = SIZE_MAX) {
+    auto it = burst_plans.find(cls);
+    if (it == burst_plans.end())
+      it = burst_plans.emplace(cls, PlanBurstReads<AT>(registers.begin(), registers.end(), include, max_length)).first;
+    return it->second;
+  }
+
+  const std::vector<BurstRead<AT>>& BurstPlan(int cls = 0) {
+    return BurstPlan(cls, [](const TRegister&) { return true; });
+  }
+
+  void RefreshBursts(const std::vector<BurstRead<AT>> &plan) {
+    for (const auto &b : plan) {
+      auto tmp = device.Read(b.address, b.length);
+      for (size_t i = 0; i < b.length; i++)
+        buffer[b.address + i] = tmp[i];
+    }
+  }
 
 public:
   RegisterTableT(DEVICE &device) : RegisterTableBase(), device(device) {}
@@ -119,23 +223,74 @@ public:
     for (auto r : registers)
       max_address = std::max(max_address, r->Address());
     buffer.resize(max_address + 1);
+    BuildIndexes(registers, address_index, name_index);
   }
-  virtual const VT& operator()(const TRegister& r) const {
+  const VT& operator()(const TRegister& r) const {
     return buffer[r.Address()];
   }
   virtual void Write(const TRegister &reg, const VT &value) {
     device.Write(reg, value);
+    buffer[reg.Address()] = value;
   }
   virtual void Write(const TRegister &reg, const TVariable &var, const VT &value) {
-    device.Write(reg, var.Set((*this)(reg), value));
+    Write(reg, var.Set((*this)(reg), value));
+  }
+
+  // Shadow writes: staged values go to the device at the next Flush(), with
+  // runs of consecutive registers written in one burst. Staging the value a
+  // register already holds is a no-op.
+  void Stage(const TRegister &reg, const VT &value) {
+    const std::lock_guard<std::mutex> lock(shadow_mtx);
+    StageLocked(reg.Address(), value);
+  }
+  void Stage(const TRegister &reg, const Variable<VT> &var, const VT &value) {
+    const std::lock_guard<std::mutex> lock(shadow_mtx);
+    StageLocked(reg.Address(), var.Set(Shadow(reg.Address()), value));
+  }
+  bool Dirty() {
+    const std::lock_guard<std::mutex> lock(shadow_mtx);
+    return !staged.empty();
+  }
+  void Flush() {
+    std::map<AT, VT> todo;
+    {
+      const std::lock_guard<std::mutex> lock(shadow_mtx);
+      todo.swap(staged);
+    }
+    auto it = todo.begin();
+    while (it != todo.end()) {
+      AT start = it->first;
+      std::vector<VT> values;
+      for (AT next = start; it != todo.end() && it->first == next; it++, next++)
+        values.push_back(it->second);
+      if (values.size() == 1)
+        device.Write(start, values[0]);
+      else
+        device.Write(start, values);
+      for (size_t i = 0; i < values.size(); i++)
+        buffer[start + i] = values[i];
+    }
   }
   virtual TRegister *Find(size_t addr)
   {
+    if (!address_index.empty())
+      return addr < address_index.size() ? address_index[addr] : nullptr;
     for (auto &r : registers)
       if (r->Address() == addr)
         return r;
     return nullptr;
   }
+  TRegister *Find(const std::string &name)
+  {
+    if (!name_index.empty()) {
+      auto it = name_index.find(name);
+      return it != name_index.end() ? it->second : nullptr;
+    }
+    for (auto &r : registers)
+      if (r->Name() == name)
+        return r;
+    return nullptr;
+  }
   void Write(TVariable &var, const VT &value) {
     for (auto &reg : registers) {
       if (reg.find_variable(var->Name()) != nullptr) {
@@ -196,6 +351,8 @@ protected:
   DEVICE &device;
   Registers registers;
   SparseBuffer<AT, std::vector<uint8_t>> buffer;
+  std::vector<TRegister*> address_index;
+  std::unordered_map<std::string, TRegister*> name_index;
 
 public:
   RegisterTableSparseVar(DEVICE &device) : RegisterTableBase(), device(device) {}
@@ -208,8 +365,9 @@ public:
   virtual void Initialize() override {
     for (auto r : registers)
       buffer.emplace(r->Address(), std::vector<uint8_t>(r->value_size(), 0));
+    BuildIndexes(registers, address_index, name_index);
   }
-  virtual const std::vector<uint8_t>& operator()(const TRegister& r) const {
+  const std::vector<uint8_t>& operator()(const TRegister& r) const {
     return buffer[r.Address()];
   }
   virtual void Write(const TRegister &reg, const std::vector<uint8_t> &value) {
@@ -220,17 +378,30 @@ public:
   }
   virtual TRegister *Find(size_t addr)
   {
+    if (!address_index.empty())
+      return addr < address_index.size() ? address_index[addr] : nullptr;
     for (auto &r : registers)
       if (r->Address() == addr)
         return r;
     return nullptr;
   }
+  TRegister *Find(const std::string &name)
+  {
+    if (!name_index.empty()) {
+      auto it = name_index.find(name);
+      return it != name_index.end() ? it->second : nullptr;
+    }
+    for (auto &r : registers)
+      if (r->Name() == name)
+        return r;
+    return nullptr;
+  }
 };
 
 
 #define REGDECL(AT, VT, N, NN, A, RW, D, V)                     \
   TRegister _r##N = TRegister(STR(N), NN, A, D, RW, registers); \
-  VT N() const { return (*this)(_r##N); }                       \
+  VT N() const { return this->buffer[A]; }                      \
   V
 
 #define VREGDECL(AT, SZ, N, NN, A, RW, D, V)                        \
@@ -238,7 +409,12 @@ public:
   const std::vector<uint8_t> &N() const { return (*this)(_r##N); }  \
   V
 
+// Scalar variables extract their field with a compile-time mask and shift.
 #define VARDECL(AT, VT, R, N, NN, M, RW, D)                 \
+  TVariable _v##N = TVariable(STR(N), NN, D, M, RW, _r##R); \
+  VT N() const { return ConstMask<(VT)(M)>::Get(R()); }
+
+#define VVARDECL(AT, VT, R, N, NN, M, RW, D)                \
   TVariable _v##N = TVariable(STR(N), NN, D, M, RW, _r##R); \
   VT N() const { return _v##N(R()); }
 
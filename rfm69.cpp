@@ -28,10 +28,8 @@ RFM69::RFM69(
   spi_channel(spi_channel),
   f_xosc(f_xosc),
   f_step(f_xosc / pow(2, 19))
-  // ,
-  // recv_buf(new uint8_t[1024]),
-  // recv_buf_sz(1024), recv_buf_begin(0), recv_buf_pos(0)
 {
+  RT->Initialize();
   Reset();
 
   SetMode(Mode::STDBY);
@@ -48,7 +46,6 @@ RFM69::RFM69(
 RFM69::~RFM69() {
   Reset();
   SetMode(Mode::SLEEP);
-  // delete[](recv_buf);
   delete(RT);
 }
 
@@ -60,44 +57,48 @@ void RFM69::Reset()
 
 uint8_t RFM69::Read(const uint8_t &addr)
 {
-  mtx.lock();
-  std::vector<uint8_t> res(2);
-  res[0] = addr & 0x7F;
-  SPIDev::Transfer(res);
-  mtx.unlock();
-  return res[1];
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t b[2] = { (uint8_t)(addr & 0x7F), 0 };
+  SPIDev::Transfer(b, 2);
+  return b[1];
 }
 
 std::vector<uint8_t> RFM69::Read(const uint8_t &addr, size_t length)
 {
-  mtx.lock();
-  std::vector<uint8_t> res(length + 1);
-  res[0] = addr & 0x7F;
-  SPIDev::Transfer(res);
-  res.erase(res.begin());
-  mtx.unlock();
+  std::vector<uint8_t> res(length);
+  Read(addr, res.data(), length);
   return res;
 }
 
+void RFM69::Read(const uint8_t &addr, uint8_t *out, size_t length)
+{
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t *b = Scratch(length + 1);
+  memset(b, 0, length + 1);
+  b[0] = addr & 0x7F;
+  SPIDev::Transfer(b, length + 1);
+  memcpy(out, b + 1, length);
+}
+
 void RFM69::Write(const uint8_t &addr, const uint8_t &value)
 {
-  mtx.lock();
-  std::vector<uint8_t> buf(2);
-  buf[0] = 0x80 | (addr & 0x7F);
-  buf[1] = value;
-  SPIDev::Transfer(buf);
-  mtx.unlock();
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t b[2] = { (uint8_t)(0x80 | (addr & 0x7F)), value };
+  SPIDev::Transfer(b, 2);
 }
 
 void RFM69::Write(const uint8_t &addr, const std::vector<uint8_t> &values)
 {
-  mtx.lock();
-  size_t n = values.size();
-  std::vector<uint8_t> buf(n+1);
-  buf[0] = 0x80 | (addr & 0x7F);;
-  memcpy(&buf[1], values.data(), n);
-  SPIDev::Transfer(buf);
-  mtx.unlock();
+  Write(addr, values.data(), values.size());
+}
+
+void RFM69::Write(const uint8_t &addr, const uint8_t *values, size_t length)
+{
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t *b = Scratch(length + 1);
+  b[0] = 0x80 | (addr & 0x7F);
+  memcpy(&b[1], values, length);
+  SPIDev::Transfer(b, length + 1);
 }
 
 RFM69::Mode RFM69::GetMode()
@@ -149,83 +150,120 @@ void RFM69::ClearFlags()
   Write(RT->_rIrqFlags2, irq2 | 0x10); // FifoOverrun
 }
 
+// The apps call this on the DIO0 edge (PayloadReady in the shipped configs).
+// Only DIO0 is wired to a GPIO there, so FIFO levels during long packets and
+// PacketSent in Transmit are polled from IrqFlags2.
 void RFM69::Receive(std::vector<uint8_t> &packet)
 {
-  const uint8_t format = RT->_vPacketFormat(Read(RT->_rPacketConfig1));
-  const uint8_t length = Read(RT->_rPayloadLength);
-  const uint8_t threshold = RT->_vFifoThreshold(Read(RT->_rFifoThresh));
+  const size_t unknown = (size_t)-1;
+  const bool variable = RT->PacketFormat() != 0;
+  const uint8_t length = RT->PayloadLength();
+  const size_t threshold = RT->FifoThreshold();
+  const double byte_us = 8 * (1e6 / rBitrate());
+  size_t expected = variable ? unknown : length;
   size_t max_wait = 5;
 
   packet.resize(0);
 
-  if (format == 0 && length == 0)
+  if (!variable && length == 0)
     throw std::runtime_error("unlimited packet length not implemented yet");
-  else {
-    packet.reserve(length);
-    while (packet.size() < length && max_wait > 0) {
-      uint8_t irqflags2 = Read(RT->_rIrqFlags2);
+
+  packet.reserve(fifo_size);
+  while (packet.size() < expected && max_wait > 0) {
+    uint8_t irqflags2 = Read(RT->_rIrqFlags2);
+    size_t n = 0;
+
+    if (expected == unknown) {
+      // Variable length: the first byte tells us how much is coming.
       if (RT->_vFifoNotEmpty(irqflags2)) {
-        if (RT->_vFifoLevel(irqflags2)) {
-          // auto p = Read(RT->_rFifo.Address(), threshold);
-          // packet.insert(packet.end(), p.begin(), p.end());
-          for (size_t i = 0; i < threshold; i++)
-            packet.push_back(Read(RT->_rFifo));
-        }
-        else
-          packet.push_back(Read(RT->_rFifo));
-      }
-      else {
-        sleep_us(8 * (1e6 / rBitrate()));
-        max_wait--;
+        packet.push_back(Read(RT->_rFifo));
+        expected = 1 + packet[0];
+        continue;
       }
     }
+    else if (RT->_vPayloadReady(irqflags2))
+      n = expected - packet.size(); // All of it is in the FIFO.
+    else if (RT->_vFifoLevel(irqflags2))
+      n = std::min(threshold + 1, expected - packet.size());
+
+    if (n > 0) {
+      size_t sz = packet.size();
+      packet.resize(sz + n);
+      Read(RT->_rFifo.Address(), packet.data() + sz, n);
+    }
+    else {
+      // Give the FIFO time to fill up to the threshold.
+      size_t wait_bytes = expected == unknown ? 1 : std::min(threshold + 1, expected - packet.size());
+      sleep_us(wait_bytes * byte_us);
+      max_wait--;
+    }
   }
-
-
-  // uint8_t crc;
-
-  // size_t rxbytes_last = 0, rxbytes = 1;
-  // while (true)
-  // {
-  //   do {
-  //     rxbytes_last = rxbytes;
-  //     rxbytes = 128; // number of bytes in fifo not available?
-  //   } while (rxbytes != rxbytes_last);
-
-  //   bool overflow = (rxbytes & 0x80) != 0;
-  //   size_t n = rxbytes & 0x7F;
-
-  //   size_t m = n <= 1 ? n : n-1;
-
-  //   if (n == 0)
-  //     break;
-  //   else if (overflow) {
-  //     break;
-  //   }
-  //   else
-  //   {
-  //     std::vector<uint8_t> buf = Read(RT->_rFifo.Address(), m);
-  //     for (uint8_t &bi : buf) {
-  //       recv_buf[recv_buf_pos++] = bi;
-  //       recv_buf_pos %= recv_buf_sz;
-  //     }
-  //   }
-
-  //   sleep_us(1000); // give the FIFO a chance to catch up
-  // }
-
-  // size_t pkt_sz = recv_buf_held(), i=0;
-  // packet.resize(pkt_sz);
-  // while (recv_buf_begin != recv_buf_pos) {
-  //   packet[i++] = recv_buf[recv_buf_begin++];
-  //   recv_buf_begin %= recv_buf_sz;
-  // }
-
-  // recv_buf_begin = recv_buf_pos;
 }
 
 void RFM69::Transmit(const std::vector<uint8_t> &pkt)
 {
+  if (pkt.empty())
+    throw std::runtime_error("empty packet");
+  if (pkt.size() > 255)
+    throw std::runtime_error("packet too large");
+
+  const size_t threshold = RT->FifoThreshold();
+  const double byte_us = 8 * (1e6 / rBitrate());
+  const uint8_t packetconfig1_before = RT->PacketConfig1();
+  const uint8_t payloadlength_before = RT->PayloadLength();
+  const uint8_t fifothresh_before = RT->FifoThresh();
+  const Mode mode_before = GetMode();
+
+  // Send as a fixed-length packet of exactly this size, starting as soon as
+  // the FIFO is not empty. These go through the register table, so that a
+  // concurrent refresh can't leave the temporary values in its buffer.
+  SetMode(Mode::STDBY);
+  RT->Stage(RT->_rPacketConfig1, RT->_vPacketFormat, 0);
+  RT->Stage(RT->_rPayloadLength, (uint8_t)pkt.size());
+  RT->Stage(RT->_rFifoThresh, RT->_vTxStartCondition, 1);
+  RT->Flush();
+
+  size_t sent = std::min(fifo_size, pkt.size());
+  Write(RT->_rFifo.Address(), pkt.data(), sent);
+  SetMode(Mode::TX);
+
+  // Refill in bursts whenever the FIFO drops to the threshold. After a
+  // refill, sleep until it has drained that far again; give up only if the
+  // FIFO stops draining.
+  size_t cnt = 0;
+  while (sent < pkt.size() && cnt++ < 100) {
+    uint8_t irqflags2 = Read(RT->_rIrqFlags2);
+    if (!RT->_vFifoLevel(irqflags2)) {
+      size_t n = std::min(fifo_size - threshold, pkt.size() - sent);
+      Write(RT->_rFifo.Address(), pkt.data() + sent, n);
+      sent += n;
+      cnt = 0;
+      sleep_us((fifo_size - threshold) * byte_us);
+    }
+    else
+      sleep_us(byte_us);
+  }
+
+  // Wait for PacketSent; the FIFO holds at most fifo_size bytes still to go.
+  bool packet_sent = false;
+  if (sent == pkt.size()) {
+    sleep_us(std::min(fifo_size, pkt.size()) * byte_us);
+    cnt = 0;
+    while (!(packet_sent = RT->_vPacketSent(Read(RT->_rIrqFlags2))) && cnt++ < 50)
+      sleep_us(8 * byte_us);
+  }
+
+  SetMode(Mode::STDBY);
+  RT->Stage(RT->_rPacketConfig1, packetconfig1_before);
+  RT->Stage(RT->_rPayloadLength, payloadlength_before);
+  RT->Stage(RT->_rFifoThresh, fifothresh_before);
+  RT->Flush();
+  SetMode(mode_before);
+
+  if (sent != pkt.size())
+    throw std::runtime_error("partial tx: " + std::to_string(sent) + "/" + std::to_string(pkt.size()));
+  if (!packet_sent)
+    throw std::runtime_error("tx timeout: PacketSent not set");
 }
 
 double RFM69::rRSSI() const {
@@ -294,14 +332,13 @@ void RFM69::RegisterTable::Set(const std::string &key, const std::string &value)
   if (value.size() != 2)
     throw std::runtime_error(std::string("invalid value length for '" + key + "'"));
   bool found = false;
-  for (const auto &r : registers)
-    if (r->Name() == key && r->Address() != 0) {
-      uint8_t val;
-      sscanf(value.c_str(), "%02hhx", &val);
-      device.Write(*r, val);
-      found = true;
-      break;
-    }
+  auto r = Find(key);
+  if (r && r->Address() != 0) {
+    uint8_t val;
+    sscanf(value.c_str(), "%02hhx", &val);
+    Stage(*r, val);
+    found = true;
+  }
   if (!found)
     throw std::runtime_error(std::string("invalid register '") + key + "'");
 }
@@ -314,15 +351,30 @@ void RFM69::RegisterTable::Read(std::istream &is)
   json j = json::parse(is);
   if (j["device"]["name"] != device.Name())
     throw std::runtime_error("device mismatch");
-  for (const auto &e : j["registers"].items()) {
-    const std::string &name = e.key();
-    if (name == "OpMode")
-      continue;
-    if (!e.value().is_string())
-      throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
-    Set(name, e.value().get<std::string>());
+
+  // Only registers that change are written, in bursts.
+  Refresh(false);
+
+  try {
+    for (const auto &e : j["registers"].items()) {
+      const std::string &name = e.key();
+      if (name == "OpMode")
+        continue;
+      if (!e.value().is_string())
+        throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
+      Set(name, e.value().get<std::string>());
+    }
   }
-  if (j["registers"].contains("OpMode"))
+  catch (...) {
+    Flush();
+    throw;
+  }
+  Flush();
+
+  // The mode goes last, after everything else is configured.
+  if (j["registers"].contains("OpMode")) {
     Set("OpMode", j["registers"]["OpMode"]);
+    Flush();
+  }
 }
 
@@ -33,14 +33,14 @@ protected:
   std::mutex mtx;
   int spi_channel;
   const double f_xosc, f_step;
-  // uint8_t *recv_buf;
-  // size_t recv_buf_sz, recv_buf_begin, recv_buf_pos;
+  static constexpr size_t fifo_size = 66;
 
 public:
   RFM69(unsigned spi_bus, unsigned spi_channel, const std::string &config_file = "", double f_xosc = 32.0*1e6);
   virtual ~RFM69();
 
   virtual const char* Name() const { return "RFM69"; }
+  virtual std::string Bus() const override { return SPIDev::Bus(); }
 
   const double& F_XOSC() const { return f_xosc; }
   const double& F_STEP() const { return f_step; }
@@ -59,9 +59,11 @@ public:
 
   virtual uint8_t Read(const uint8_t &addr);
   virtual std::vector<uint8_t> Read(const uint8_t &addr, size_t length);
+  void Read(const uint8_t &addr, uint8_t *out, size_t length);
 
   virtual void Write(const uint8_t &addr, const uint8_t &value);
   virtual void Write(const uint8_t &addr, const std::vector<uint8_t> &values);
+  void Write(const uint8_t &addr, const uint8_t *values, size_t length);
 
   uint8_t Read(const Register<uint8_t, uint8_t> &r) { return Device::Read(r); }
   void Write(const Register<uint8_t, uint8_t> &r, const uint8_t &v) { Device::Write(r, v); }
@@ -80,13 +82,6 @@ public:
   double rRSSI() const;
   uint64_t rSyncWord() const;
   double rBitrate() const;
-
-protected:
-  // inline size_t recv_buf_held() const {
-  //   return recv_buf_begin <= recv_buf_pos ?
-  //               (recv_buf_pos - recv_buf_begin) :
-  //               (recv_buf_sz - recv_buf_begin + recv_buf_pos);
-  // }
 };
 
 #endif // _RFM69_H_
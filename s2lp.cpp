@@ -20,10 +20,12 @@ S2LP::S2LP(unsigned spi_bus, unsigned spi_channel, const std::string &config_fil
   SPIDev(spi_bus, spi_channel, 10000000),
   RT(new RegisterTable(*this)),
   f_xo(f_xo),
-  tx_done(true),
+  tx_timeout(0),
+  tx_stream_pos(0),
+  rx_complete(false),
   irq_mask(0xFFFFFFFF)
 {
-  FindAddressBlocks();
+  RT->Initialize();
   Reset();
 
   if (!config_file.empty()) {
@@ -44,29 +46,6 @@ S2LP::S2LP(unsigned spi_bus, unsigned spi_channel, const std::string &config_fil
 
 S2LP::~S2LP() {}
 
-void S2LP::FindAddressBlocks()
-{
-  if (address_blocks.empty())
-  {
-    bool used_addrs[256] = {false};
-    for (const auto &r : *RT)
-      if (r->Readable())
-        used_addrs[r->Address()] = true;
-    size_t start = SIZE_MAX;
-    for (size_t i=0; i < 256; i++)
-    {
-      if (used_addrs[i]) {
-        if (start == SIZE_MAX)
-          start = i;
-      }
-      else if (start != SIZE_MAX) {
-        address_blocks.push_back(std::make_pair(start, i-1));
-        start = SIZE_MAX;
-      }
-    }
-  }
-}
-
 void S2LP::Reset()
 {
   Strobe(Command::SRES);
@@ -81,50 +60,55 @@ void S2LP::Reset()
 uint8_t S2LP::Read(const uint8_t &addr)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> res(3, 0);
-  res[0] = 0x01;
-  res[1] = addr;
-  SPIDev::Transfer(res);
-  status_bytes[0] = res[0];
-  status_bytes[1] = res[1];
-  return res[2];
+  uint8_t b[3] = { 0x01, addr, 0 };
+  SPIDev::Transfer(b, 3);
+  status_bytes[0] = b[0];
+  status_bytes[1] = b[1];
+  return b[2];
 }
 
 std::vector<uint8_t> S2LP::Read(const uint8_t &addr, size_t length)
 {
-  const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> res(length + 2, 0);
-  res[0] = 0x01;
-  res[1] = addr;
-  SPIDev::Transfer(res);
-  status_bytes[0] = res[0];
-  status_bytes[1] = res[1];
-  res.erase(res.begin());
-  res.erase(res.begin());
+  std::vector<uint8_t> res(length);
+  Read(addr, res.data(), length);
   return res;
 }
 
-void S2LP::Write(const uint8_t &addr, const uint8_t &value)
+void S2LP::Read(const uint8_t &addr, uint8_t *out, size_t length)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> b(3);
-  b[0] = 0x00;
+  uint8_t *b = Scratch(length + 2);
+  memset(b, 0, length + 2);
+  b[0] = 0x01;
   b[1] = addr;
-  b[2] = value;
-  SPIDev::Transfer(b);
+  SPIDev::Transfer(b, length + 2);
+  status_bytes[0] = b[0];
+  status_bytes[1] = b[1];
+  memcpy(out, b + 2, length);
+}
+
+void S2LP::Write(const uint8_t &addr, const uint8_t &value)
+{
+  const std::lock_guard<std::mutex> lock(mtx);
+  uint8_t b[3] = { 0x00, addr, value };
+  SPIDev::Transfer(b, 3);
   status_bytes[0] = b[0];
   status_bytes[1] = b[1];
 }
 
 void S2LP::Write(const uint8_t &addr, const std::vector<uint8_t> &values)
+{
+  Write(addr, values.data(), values.size());
+}
+
+void S2LP::Write(const uint8_t &addr, const uint8_t *values, size_t length)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  size_t n = values.size();
-  std::vector<uint8_t> b(n+2);
+  uint8_t *b = Scratch(length + 2);
   b[0] = 0x00;
   b[1] = addr;
-  memcpy(&b[2], values.data(), n);
-  SPIDev::Transfer(b);
+  memcpy(&b[2], values, length);
+  SPIDev::Transfer(b, length + 2);
   status_bytes[0] = b[0];
   status_bytes[1] = b[1];
 }
@@ -132,8 +116,8 @@ void S2LP::Write(const uint8_t &addr, const std::vector<uint8_t> &values)
 void S2LP::Strobe(S2LP::Command cmd, size_t delay_us)
 {
   const std::lock_guard<std::mutex> lock(mtx);
-  std::vector<uint8_t> b = { 0x80, static_cast<uint8_t>(cmd) };
-  SPIDev::Transfer(b);
+  uint8_t b[2] = { 0x80, static_cast<uint8_t>(cmd) };
+  SPIDev::Transfer(b, 2);
 }
 
 void S2LP::StrobeFor(S2LP::Command cmd, S2LP::State st, size_t delay_us)
@@ -188,6 +172,11 @@ Radio::State S2LP::GetState() const
 
 bool S2LP::RXReady()
 {
+  {
+    const std::lock_guard<std::mutex> lock(rx_mtx);
+    if (rx_complete)
+      return true;
+  }
   status_bytes[0] = Read(RT->_rMC_STATE1);
   status_bytes[1] = Read(RT->_rMC_STATE0);
   return (status_bytes[0] & 0x02) == 0;
@@ -208,15 +197,32 @@ double S2LP::LQI()
 void S2LP::Receive(std::vector<uint8_t> &pkt)
 {
   DisableIRQs();
-  pkt.clear();
 
-  do
+  bool complete;
   {
-    uint8_t num_available = Read(RT->_rRX_FIFO_STATUS);
-    auto t = Read(0xFF, num_available);
-    pkt.insert(pkt.end(), t.begin(), t.end());
+    const std::lock_guard<std::mutex> lock(rx_mtx);
+    pkt.swap(rx_stream);
+    rx_stream.clear();
+    complete = rx_complete;
+    rx_complete = false;
+  }
+
+  if (!complete) {
+    // Not (fully) streamed by IRQHandler; pick up whatever is left, up to
+    // the configured packet length (the maximum, for variable length).
+    size_t max_sz = (RT->PCKTLEN1() << 8) | RT->PCKTLEN0();
+    if (max_sz == 0)
+      max_sz = 255;
+    while (pkt.size() < max_sz)
+    {
+      size_t sz = pkt.size();
+      size_t num_available = std::min<size_t>(Read(RT->_rRX_FIFO_STATUS), max_sz - sz);
+      pkt.resize(sz + num_available);
+      Read(0xFF, pkt.data() + sz, num_available);
+      if ((status_bytes[0] & 0x02) != 0)
+        break;
+    }
   }
-  while ((status_bytes[0] & 0x02) == 0 && pkt.size() < 255);
 
   if (RT->RX_MODE() == 0x01)
     Strobe(Command::SABORT);
@@ -224,51 +230,102 @@ void S2LP::Receive(std::vector<uint8_t> &pkt)
   EnableIRQs();
 }
 
+void S2LP::DrainRXFIFO()
+{
+  const std::lock_guard<std::mutex> lock(rx_mtx);
+  size_t n = Read(RT->_rRX_FIFO_STATUS);
+  if (n > 0) {
+    size_t sz = rx_stream.size();
+    rx_stream.resize(sz + n);
+    Read(0xFF, rx_stream.data() + sz, n);
+  }
+}
+
+void S2LP::RefillTXFIFO()
+{
+  const std::lock_guard<std::mutex> lock(tx_pending_mtx);
+  if (tx_stream_pos >= tx_stream.size())
+    return;
+  size_t held = Read(RT->_rTX_FIFO_STATUS);
+  size_t n = std::min(fifo_size - std::min(held, fifo_size), tx_stream.size() - tx_stream_pos);
+  Write(0xFF, tx_stream.data() + tx_stream_pos, n);
+  tx_stream_pos += n;
+}
+
 uint32_t S2LP::GetIRQs()
 {
-  return (Read(RT->_rIRQ_STATUS3) << 24) |
-         (Read(RT->_rIRQ_STATUS2) << 16) |
-         (Read(RT->_rIRQ_STATUS1) << 8) |
-          Read(RT->_rIRQ_STATUS0);
+  // IRQ_STATUS[3:0] are consecutive, most significant byte first.
+  uint8_t s[4];
+  Read(RT->_rIRQ_STATUS3.Address(), s, 4);
+  return ((uint32_t)s[0] << 24) | ((uint32_t)s[1] << 16) | ((uint32_t)s[2] << 8) | s[3];
+}
+
+void S2LP::WriteIRQMask(uint32_t mask)
+{
+  uint8_t m[4] = { (uint8_t)(mask >> 24), (uint8_t)(mask >> 16), (uint8_t)(mask >> 8), (uint8_t)mask };
+  Write(RT->_rIRQ_MASK3.Address(), m, 4);
 }
 
 void S2LP::EnableIRQs()
 {
-  Write(RT->_rIRQ_MASK3, (irq_mask >> 24) & 0xFF);
-  Write(RT->_rIRQ_MASK2, (irq_mask >> 16) & 0xFF);
-  Write(RT->_rIRQ_MASK1, (irq_mask >> 8) & 0xFF);
-  Write(RT->_rIRQ_MASK0, (irq_mask) & 0xFF);
+  WriteIRQMask(irq_mask);
 }
 
 void S2LP::DisableIRQs()
 {
-  Write(RT->_rIRQ_MASK3, 0);
-  Write(RT->_rIRQ_MASK2, 0);
-  Write(RT->_rIRQ_MASK1, 0);
-  Write(RT->_rIRQ_MASK0, 0);
+  WriteIRQMask(0);
 }
 
-void S2LP::Transmit(const std::vector<uint8_t> &pkt)
+std::chrono::microseconds S2LP::TXTimeout(size_t sz) const
 {
+  // Time on air, with room for preamble and sync, plus some slack.
+  double rate = rDatarate();
+  uint64_t us = 10000;
+  if (rate > 0)
+    us += (sz + 16) * 8e6 / rate;
+  return std::chrono::microseconds(us);
+}
+
+std::shared_ptr<TXCompletion> S2LP::TransmitAsync(const std::vector<uint8_t> &pkt)
+{
+  const std::lock_guard<std::mutex> lock(tx_mtx);
+
+  // Only one packet can be on air; let the previous one go out first.
+  std::shared_ptr<TXCompletion> previous;
+  {
+    const std::lock_guard<std::mutex> plock(tx_pending_mtx);
+    previous = tx_pending;
+  }
+  if (previous)
+    previous->Wait(tx_timeout);
+
   Strobe(Command::SABORT);
   StrobeFor(Command::READY, State::READY, 100);
 
   DisableIRQs();
 
   Strobe(Command::FLUSHTXFIFO);
-  Write(0xFF, pkt);
+  size_t first = std::min(pkt.size(), fifo_size);
+  Write(0xFF, pkt.data(), first);
 
-  tx_done = false;
+  auto completion = std::make_shared<TXCompletion>();
+  {
+    const std::lock_guard<std::mutex> plock(tx_pending_mtx);
+    tx_pending = completion;
+    tx_stream.assign(pkt.begin() + first, pkt.end());
+    tx_stream_pos = 0;
+  }
+  tx_timeout = TXTimeout(pkt.size());
 
   EnableIRQs();
-
   Strobe(Command::TX);
 
-  size_t retries = 100;
-  while (!tx_done && retries-- != 0)
-    sleep_us(100);
+  return completion;
+}
 
-  tx_done = true;
+void S2LP::Transmit(const std::vector<uint8_t> &pkt)
+{
+  TransmitAsync(pkt)->Wait(TXTimeout(pkt.size()));
 }
 
 void S2LP::UpdateFrequent() { RT->Refresh(true); }
@@ -292,10 +349,11 @@ void S2LP::wFrequency(double f)
   double D = RT->REFDIV() == 0 ? 1.0 :  2.0;
   double Q = F_xo() / ((B*D)/2.0);
   uint32_t SYNT = (f * pow(2, 20)) / Q;
-  Write(RT->_rSYNT0, RT->_vSYNT_7_0, SYNT);
-  Write(RT->_rSYNT1, RT->_vSYNT_15_8, (SYNT >> 8) & 0xFF);
-  Write(RT->_rSYNT2, RT->_vSYNT_23_16, (SYNT >> 16) & 0xFF);
-  Write(RT->_rSYNT3, RT->_vSYNT_27_24, (SYNT >> 24) & 0x0F);
+  RT->Stage(RT->_rSYNT0, RT->_vSYNT_7_0, SYNT & 0xFF);
+  RT->Stage(RT->_rSYNT1, RT->_vSYNT_15_8, (SYNT >> 8) & 0xFF);
+  RT->Stage(RT->_rSYNT2, RT->_vSYNT_23_16, (SYNT >> 16) & 0xFF);
+  RT->Stage(RT->_rSYNT3, RT->_vSYNT_27_24, (SYNT >> 24) & 0x0F);
+  RT->Flush();
 }
 
 double S2LP::rDeviation() const
@@ -328,9 +386,10 @@ void S2LP::wDatarate(double f)
   uint16_t drate_m = ((f * pow(2, 28)) / (f_dig * pow(2, drate_e))) - 256;
   if (drate_m == 0)
     drate_e++;
-  Write(RT->_rMOD1, RT->_vDATARATE_M_15_8, drate_m >> 8);
-  Write(RT->_rMOD1, RT->_vDATARATE_M_7_0, drate_m & 0x00FF);
-  Write(RT->_rMOD0, RT->_vDATARATE_E, drate_e);
+  RT->Stage(RT->_rMOD4, RT->_vDATARATE_M_15_8, drate_m >> 8);
+  RT->Stage(RT->_rMOD3, RT->_vDATARATE_M_7_0, drate_m & 0x00FF);
+  RT->Stage(RT->_rMOD2, RT->_vDATARATE_E, drate_e);
+  RT->Flush();
 }
 
 static float filter_bandwidths[9][10] = {
@@ -358,10 +417,32 @@ double S2LP::rRSSIThreshold() const
 uint64_t S2LP::IRQHandler()
 {
   uint32_t irqs = GetIRQs();
-  if (irqs & 0x00000004)
-    tx_done = true;
+  if (irqs & 0x00000100) { // TX_FIFO_ALMOST_EMPTY
+    RefillTXFIFO();
+    irqs = irqs & ~0x00000100;
+  }
+  if (irqs & 0x00000004) {
+    const std::lock_guard<std::mutex> lock(tx_pending_mtx);
+    if (tx_pending) {
+      tx_pending->Signal();
+      tx_pending.reset();
+    }
+    tx_stream.clear();
+    tx_stream_pos = 0;
+  }
+  if (irqs & 0x00000200) { // RX_FIFO_ALMOST_FULL
+    DrainRXFIFO();
+    irqs = irqs & ~0x00000200;
+  }
+  if (irqs & 0x00000001) { // RX_DATA_READY
+    DrainRXFIFO();
+    const std::lock_guard<std::mutex> lock(rx_mtx);
+    rx_complete = true;
+  }
   if (irqs & 0x00000002) {
     Strobe(Command::FLUSHRXFIFO);
+    const std::lock_guard<std::mutex> lock(rx_mtx);
+    rx_stream.clear();
     irqs = irqs & ~0x00000002;
   }
   return irqs;
@@ -376,11 +457,10 @@ void S2LP::RegisterTable::Refresh(bool frequent)
     device.mtx.unlock();
   }
   if (!frequent) {
-    for (const auto &b : device.address_blocks) {
-      size_t sz = b.second-b.first+1;
-      auto tmp = device.Read(b.first, sz);
-      memcpy(buffer.data() + b.first, tmp.data(), sz);
-    }
+    // IRQ_STATUS3..0 clear on read; they belong to the IRQ handler.
+    RefreshBursts(BurstPlan(0, [this](const TRegister &r) {
+      return r.Address() < _rIRQ_STATUS3.Address() || r.Address() > _rIRQ_STATUS0.Address();
+    }));
     device.f_dig = PD_CLKDIV() ? device.f_xo : device.f_xo / 2.0;
   }
 }
@@ -408,27 +488,35 @@ void S2LP::RegisterTable::Read(std::istream &is)
   if (j["device"]["name"] != device.Name())
     throw std::runtime_error("device mismatch");
 
-  for (const auto &e : j["registers"].items())
-  {
-    if (!e.value().is_string())
-      throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
-    std::string sval = e.value().get<std::string>();
-    if (sval.size() != 2)
-      throw std::runtime_error(std::string("invalid value length for '" + e.key() + "'"));
-    bool found = false;
-    for (const auto reg : registers)
+  // Only registers that change are written, in bursts.
+  Refresh(false);
+
+  try {
+    for (const auto &e : j["registers"].items())
     {
-      if (reg->Name() == e.key() && reg->Writeable()) {
+      if (!e.value().is_string())
+        throw std::runtime_error(std::string("invalid value for '" + e.key() + "'"));
+      std::string sval = e.value().get<std::string>();
+      if (sval.size() != 2)
+        throw std::runtime_error(std::string("invalid value length for '" + e.key() + "'"));
+      bool found = false;
+      auto reg = Find(e.key());
+      if (reg && reg->Writeable()) {
         uint8_t val;
         sscanf(sval.c_str(), "%02hhx", &val);
-        device.Write(*reg, val);
+        Stage(*reg, val);
         found = true;
-        break;
       }
+      if (!found)
+        throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
     }
-    if (!found)
-      throw std::runtime_error(std::string("invalid register '") + e.key() + "'");
   }
+  catch (...) {
+    Flush();
+    throw;
+  }
+
+  Flush();
 }
 
 uint8_t S2LP::pqi() { return RT->PQI(); }
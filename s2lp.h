@@ -8,11 +8,14 @@
 #include <vector>
 #include <stdexcept>
 #include <mutex>
+#include <memory>
+#include <chrono>
 
 #include "device.h"
 #include "register.h"
 #include "spidev.h"
 #include "radio.h"
+#include "tx_completion.h"
 
 class S2LP : public Device<uint8_t, uint8_t>, public SPIDev, public Radio
 {
@@ -34,6 +37,7 @@ public:
   };
 
   virtual const char* Name() const override { return "S2LP"; }
+  virtual std::string Bus() const override { return SPIDev::Bus(); }
 
   const double& F_xo() const { return f_xo; }
   const double& F_dig() const { return f_dig; }
@@ -47,6 +51,9 @@ public:
   virtual Radio::State GetState() const override;
   virtual void Receive(std::vector<uint8_t> &pkt) override;
   virtual void Transmit(const std::vector<uint8_t> &pkt) override;
+  // Starts the transmission and returns without waiting for it; the handle
+  // completes when IRQHandler sees TX_DATA_SENT.
+  std::shared_ptr<TXCompletion> TransmitAsync(const std::vector<uint8_t> &pkt);
   virtual bool RXReady() override;
 
   using Device::Read;
@@ -54,9 +61,11 @@ public:
 
   virtual uint8_t Read(const uint8_t &addr) override;
   virtual std::vector<uint8_t> Read(const uint8_t &addr, size_t length) override;
+  void Read(const uint8_t &addr, uint8_t *out, size_t length);
 
   virtual void Write(const uint8_t &addr, const uint8_t &value) override;
   virtual void Write(const uint8_t &addr, const std::vector<uint8_t> &values) override;
+  void Write(const uint8_t &addr, const uint8_t *values, size_t length);
 
   uint8_t Read(const Register<uint8_t, uint8_t> &r) override { return Device::Read(r); }
   void Write(const Register<uint8_t, uint8_t> &r, const uint8_t &v) override { Device::Write(r, v); }
@@ -101,15 +110,29 @@ public:
 protected:
   std::mutex mtx;
   double f_xo, f_dig;
-  std::vector<std::pair<uint8_t, uint8_t>> address_blocks;
   uint8_t status_bytes[2];
-  volatile bool tx_done;
+  std::mutex tx_mtx, tx_pending_mtx;
+  std::shared_ptr<TXCompletion> tx_pending;
+  std::chrono::microseconds tx_timeout;
 
-  void FindAddressBlocks();
+  std::chrono::microseconds TXTimeout(size_t sz) const;
+
+  // Packets larger than the FIFO stream through it on the FIFO almost-full
+  // (RX) and almost-empty (TX) IRQs, in bursts of whatever the FIFO holds.
+  static constexpr size_t fifo_size = 128;
+  std::vector<uint8_t> tx_stream;
+  size_t tx_stream_pos;
+  std::mutex rx_mtx;
+  std::vector<uint8_t> rx_stream;
+  bool rx_complete;
+
+  void RefillTXFIFO();
+  void DrainRXFIFO();
 
   uint32_t irq_mask;
   void EnableIRQs();
   void DisableIRQs();
+  void WriteIRQMask(uint32_t mask);
 };
 
 #endif // _S2LP_H_
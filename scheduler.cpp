@@ -0,0 +1,120 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#include <cmath>
+#include <algorithm>
+
+#include "update_pool.h"
+#include "scheduler.h"
+
+Scheduler::Scheduler(UpdatePool &pool) :
+  pool(pool),
+  defaults{ UINT64_MAX, UINT64_MAX, UINT64_MAX }
+{}
+
+void Scheduler::SetDefaults(uint64_t timed_ns, uint64_t frequent_ns, uint64_t infrequent_ns)
+{
+  defaults[(int)Kind::Timed] = timed_ns;
+  defaults[(int)Kind::Frequent] = frequent_ns;
+  defaults[(int)Kind::Infrequent] = infrequent_ns;
+}
+
+uint64_t Scheduler::PeriodFor(const DeviceBase &device, Kind kind) const
+{
+  double requested = 0.0;
+
+  switch (kind) {
+    case Kind::Timed: {
+      double f = device.TimerFrequency();
+      requested = f != 0 ? 1.0 / f : 0.0;
+      break;
+    }
+    case Kind::Frequent: requested = device.FrequentPeriod(); break;
+    case Kind::Infrequent: requested = device.InfrequentPeriod(); break;
+  }
+
+  if (requested > 0)
+    return std::max(std::llround(requested * 1e9), 1ll);
+  else
+    return defaults[(int)kind];
+}
+
+uint64_t Scheduler::Slot::Period() const
+{
+  unsigned backoff = std::min(failures.load(), max_backoff);
+  if (period == UINT64_MAX || (period << backoff) >> backoff != period)
+    return UINT64_MAX;
+  return period << backoff;
+}
+
+void Scheduler::SetDevices(const std::vector<std::shared_ptr<DeviceBase>> &devices, uint64_t now)
+{
+  slots.clear();
+  queue = {};
+
+  for (auto &device : devices) {
+    for (Kind kind : { Kind::Timed, Kind::Frequent, Kind::Infrequent }) {
+      uint64_t period = PeriodFor(*device, kind);
+      if (period == UINT64_MAX)
+        continue;
+      auto slot = std::make_shared<Slot>();
+      slot->device = device;
+      slot->kind = kind;
+      slot->period = period;
+      slot->failures = 0;
+      slots.push_back(slot);
+      queue.push({ now, slot });
+    }
+  }
+}
+
+bool Scheduler::Submit(const std::shared_ptr<Slot> &slot)
+{
+  return pool.Submit(slot->device, (int)slot->kind, [slot](DeviceBase &d) {
+    try {
+      switch (slot->kind) {
+        case Kind::Timed: d.UpdateTimed(); break;
+        case Kind::Frequent: d.UpdateFrequent(); break;
+        case Kind::Infrequent: d.UpdateInfrequent(); break;
+      }
+      slot->failures = 0;
+    }
+    catch (...) {
+      slot->failures++;
+      throw;
+    }
+  });
+}
+
+uint64_t Scheduler::Dispatch(uint64_t now)
+{
+  while (!queue.empty() && queue.top().deadline <= now) {
+    Entry e = queue.top();
+    queue.pop();
+
+    // If the device is still busy, this update is skipped (and counted as
+    // an overrun by the pool).
+    Submit(e.slot);
+
+    uint64_t period = e.slot->Period();
+    if (period == UINT64_MAX)
+      continue;
+    e.deadline += period;
+    if (e.deadline <= now)
+      e.deadline = now + period;
+    queue.push(e);
+  }
+
+  return NextDeadline();
+}
+
+uint64_t Scheduler::NextDeadline() const
+{
+  return queue.empty() ? UINT64_MAX : queue.top().deadline;
+}
+
+void Scheduler::ResetBackoff()
+{
+  for (auto &slot : slots)
+    slot->failures = 0;
+}
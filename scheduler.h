@@ -0,0 +1,66 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "device.h"
+
+class UpdatePool;
+
+// Dispatches timed, frequent and infrequent device updates to an UpdatePool
+// at absolute CLOCK_MONOTONIC deadlines (in ns). Every device gets its own
+// periods and its own exponential backoff when updates throw.
+class Scheduler {
+public:
+  enum class Kind { Timed = 0, Frequent = 1, Infrequent = 2 };
+
+  Scheduler(UpdatePool &pool);
+  virtual ~Scheduler() {}
+
+  // Default periods for devices that don't ask for their own; UINT64_MAX disables.
+  void SetDefaults(uint64_t timed_ns, uint64_t frequent_ns, uint64_t infrequent_ns);
+
+  void SetDevices(const std::vector<std::shared_ptr<DeviceBase>> &devices, uint64_t now);
+
+  // Submits all updates that are due and returns the next deadline.
+  uint64_t Dispatch(uint64_t now);
+
+  uint64_t NextDeadline() const;
+
+  void ResetBackoff();
+
+  static constexpr unsigned max_backoff = 8;
+
+protected:
+  struct Slot {
+    std::shared_ptr<DeviceBase> device;
+    Kind kind;
+    uint64_t period;
+    std::atomic<unsigned> failures;
+
+    uint64_t Period() const;
+  };
+
+  struct Entry {
+    uint64_t deadline;
+    std::shared_ptr<Slot> slot;
+    bool operator>(const Entry &other) const { return deadline > other.deadline; }
+  };
+
+  UpdatePool &pool;
+  uint64_t defaults[3];
+  std::vector<std::shared_ptr<Slot>> slots;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+  uint64_t PeriodFor(const DeviceBase &device, Kind kind) const;
+  bool Submit(const std::shared_ptr<Slot> &slot);
+};
+
+#endif // _SCHEDULER_H_
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <cstring>
 #include <csignal>
 #include <memory>
@@ -38,14 +39,23 @@ static void signal_handler(int signal)
 
 Shell::Shell(double frequency,
   size_t frequent_interval,
-  size_t infrequent_interval)
+  size_t infrequent_interval,
+  bool headless)
 {
   if (Shell::instance)
     throw std::logic_error("Shell is a singleton; use Get()");
 
-  UI::Start();
+  if (getenv("WLMCD_HEADLESS"))
+    headless = true;
+
+  UI::Start(headless);
 
   controller = std::make_unique<Controller>(frequency, frequent_interval, infrequent_interval);
+  controller->OnSignal(signal_handler);
+
+  const char *control_socket = getenv("WLMCD_CONTROL_SOCKET");
+  if (control_socket && *control_socket)
+    controller->Listen(control_socket);
 
   std::signal(SIGINT, signal_handler);
   std::signal(SIGABRT, signal_handler);
@@ -59,9 +69,10 @@ Shell::~Shell()
 std::shared_ptr<Shell> get_shell(
   double frequency,
   size_t frequent_interval,
-  size_t infrequent_interval)
+  size_t infrequent_interval,
+  bool headless)
 {
   if (!Shell::instance)
-    Shell::instance = std::make_shared<Shell>(frequency, frequent_interval, infrequent_interval);
+    Shell::instance = std::make_shared<Shell>(frequency, frequent_interval, infrequent_interval, headless);
   return Shell::instance;
 }
@@ -20,12 +20,16 @@ public:
   static std::shared_ptr<Shell> instance;
   Shell(double frequency = 1 /* Hz */,
         size_t frequent_interval=17,
-        size_t infrequent_interval=71);
+        size_t infrequent_interval=71,
+        bool headless=false);
 };
 
+// Headless mode (no curses, commands on stdin) is also selected by setting
+// WLMCD_HEADLESS; WLMCD_CONTROL_SOCKET names a socket to accept commands on.
 std::shared_ptr<Shell> get_shell(
   double frequency = 1 /* Hz */,
   size_t frequent_interval=17,
-  size_t infrequent_interval=71);
+  size_t infrequent_interval=71,
+  bool headless=false);
 
 #endif // _SHELL_H_
\ No newline at end of file
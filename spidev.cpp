@@ -2,7 +2,6 @@
 // Licensed under the MIT License.
 
 #include <fcntl.h>
-#include <linux/spi/spidev.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -13,7 +12,9 @@
 #include "spidev.h"
 
 SPIDev::SPIDev(unsigned bus, unsigned channel, uint32_t speed) :
-  fd(-1)
+  bus(bus),
+  fd(-1),
+  scratch(258)
 {
   snprintf(path, sizeof(path), "/dev/spidev%d.%d", bus, channel);
 
@@ -40,31 +41,60 @@ SPIDev::~SPIDev()
 
 void SPIDev::Transfer(std::vector<uint8_t> &data) const
 {
-  std::vector<uint8_t> rx;
-  struct spi_ioc_transfer spi;
+  Transfer(data.data(), data.data(), data.size());
+}
+
+void SPIDev::Transfer(uint8_t *buf, size_t sz) const
+{
+  Transfer(buf, buf, sz);
+}
 
-  rx.resize(data.size());
+void SPIDev::Transfer(const uint8_t *tx, uint8_t *rx, size_t sz) const
+{
+  struct spi_ioc_transfer spi;
 
   memset(&spi, 0, sizeof (spi));
-  spi.tx_buf        = (uint64_t)data.data();
-  spi.rx_buf        = (uint64_t)rx.data();
-  spi.len           = data.size();
+  spi.tx_buf        = (uint64_t)tx;
+  spi.rx_buf        = (uint64_t)rx;
+  spi.len           = sz;
 
   if (ioctl(fd, SPI_IOC_MESSAGE(1), &spi) == -1)
     throw std::runtime_error("SPI transfer failed");
+}
 
-  data.swap(rx);
+SPIDev::Transaction::Transaction(const SPIDev &dev, size_t capacity) :
+  dev(dev)
+{
+  transfers.reserve(capacity);
 }
 
-void SPIDev::Transfer(uint8_t *buf, size_t sz) const
+SPIDev::Transaction& SPIDev::Transaction::Add(const uint8_t *tx, uint8_t *rx, size_t len, bool cs_change, uint16_t delay_us, uint32_t speed_hz)
 {
   struct spi_ioc_transfer spi;
 
   memset(&spi, 0, sizeof (spi));
-  spi.tx_buf        = (uint64_t)buf;
-  spi.rx_buf        = (uint64_t)buf;
-  spi.len           = sz;
+  spi.tx_buf        = (uint64_t)tx;
+  spi.rx_buf        = (uint64_t)rx;
+  spi.len           = len;
+  spi.cs_change     = cs_change ? 1 : 0;
+  spi.delay_usecs   = delay_us;
+  spi.speed_hz      = speed_hz;
+
+  transfers.push_back(spi);
+  return *this;
+}
 
-  if (ioctl(fd, SPI_IOC_MESSAGE(1), &spi) == -1)
+void SPIDev::Transaction::Submit()
+{
+  size_t n = transfers.size();
+  if (n == 0)
+    return;
+
+  if (SPI_MSGSIZE(n) == 0)
+    throw std::runtime_error("SPI transaction too long");
+
+  // SPI_IOC_MESSAGE(n) with n only known at runtime.
+  unsigned long req = _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, SPI_MSGSIZE(n));
+  if (ioctl(dev.fd, req, transfers.data()) == -1)
     throw std::runtime_error("SPI transfer failed");
-}
\ No newline at end of file
+}
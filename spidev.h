@@ -4,7 +4,10 @@
 #ifndef _SPIDEV_H_
 #define _SPIDEV_H_
 
+#include <linux/spi/spidev.h>
+
 #include <cstdint>
+#include <string>
 #include <vector>
 
 class SPIDev {
@@ -12,12 +15,56 @@ public:
   SPIDev(unsigned bus, unsigned channel, uint32_t speed = 10000000);
   virtual ~SPIDev();
 
+  // Full-duplex transfers; tx and rx may be the same buffer.
   void Transfer(std::vector<uint8_t> &data) const;
   void Transfer(uint8_t *buf, size_t sz) const;
+  void Transfer(const uint8_t *tx, uint8_t *rx, size_t sz) const;
+
+  // A sequence of transfers that is submitted in a single SPI_IOC_MESSAGE(n)
+  // ioctl. Buffers are not copied; they must stay alive until Submit()
+  // returns. With cs_change, chip select is released after the transfer
+  // (or kept asserted, if it's the last one).
+  class Transaction {
+  public:
+    Transaction(const SPIDev &dev, size_t capacity = 4);
+    virtual ~Transaction() {}
+
+    Transaction& Add(const uint8_t *tx, uint8_t *rx, size_t len,
+                     bool cs_change = false, uint16_t delay_us = 0, uint32_t speed_hz = 0);
+    Transaction& Add(uint8_t *buf, size_t len,
+                     bool cs_change = false, uint16_t delay_us = 0, uint32_t speed_hz = 0) {
+      return Add(buf, buf, len, cs_change, delay_us, speed_hz);
+    }
+    Transaction& Add(std::vector<uint8_t> &buf,
+                     bool cs_change = false, uint16_t delay_us = 0, uint32_t speed_hz = 0) {
+      return Add(buf.data(), buf.data(), buf.size(), cs_change, delay_us, speed_hz);
+    }
+
+    void Submit();
+    void Clear() { transfers.clear(); }
+    size_t Size() const { return transfers.size(); }
+
+  protected:
+    const SPIDev &dev;
+    std::vector<struct spi_ioc_transfer> transfers;
+  };
+
+  std::string Bus() const { return "spi" + std::to_string(bus); }
 
 protected:
+  unsigned bus;
   char path[256];
   int fd;
+
+  // Per-device space for building transfers, so that register and FIFO
+  // access doesn't allocate. Callers serialize access (device mutex).
+  std::vector<uint8_t> scratch;
+
+  uint8_t* Scratch(size_t sz) {
+    if (scratch.size() < sz)
+      scratch.resize(sz);
+    return scratch.data();
+  }
 };
 
 #endif // _SPIDEV_H_
\ No newline at end of file
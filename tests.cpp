@@ -3,6 +3,8 @@
 
 #include "evohome_tests.h"
 #include "radbot_tests.h"
+#include "crc_tests.h"
+#include "bitstream_tests.h"
 
 int main(int argc, const char **argv)
 {
@@ -12,6 +14,10 @@ int main(int argc, const char **argv)
     r = 1;
   if (radbot_tests(argc, argv))
     r = 1;
+  if (crc_tests(argc, argv))
+    r = 1;
+  if (bitstream_tests(argc, argv))
+    r = 1;
 
   return r;
 }
@@ -0,0 +1,46 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _TX_COMPLETION_H_
+#define _TX_COMPLETION_H_
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+// Completion handle for one asynchronous transmission. The radio driver
+// signals it from its IRQ handler once the packet is on air.
+class TXCompletion {
+public:
+  TXCompletion() : done(false) {}
+  virtual ~TXCompletion() {}
+
+  void Signal()
+  {
+    {
+      const std::lock_guard<std::mutex> lock(mtx);
+      done = true;
+    }
+    cv.notify_all();
+  }
+
+  bool Done() const
+  {
+    const std::lock_guard<std::mutex> lock(mtx);
+    return done;
+  }
+
+  // Returns false if the timeout expired before completion.
+  bool Wait(std::chrono::microseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cv.wait_for(lock, timeout, [this]() { return done; });
+  }
+
+protected:
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  bool done;
+};
+
+#endif // _TX_COMPLETION_H_
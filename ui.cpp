@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #include <cmath>
+#include <cstdarg>
 #include <cstring>
 #include <regex>
 
@@ -15,6 +16,7 @@ unsigned  UI::screen_height = 0, UI::screen_width = 0;
 uint64_t UI::reset_cnt = 0;
 uint64_t UI::indicator_value = 0, UI::max_indicator_value = 0;
 FILE *UI::logfile = NULL;
+bool UI::headless = false;
 
 UI::UI() :
   logp_scrollback(0),
@@ -42,8 +44,13 @@ void UI::SetLogFile(const std::string &log_file_name)
     logfile = fopen(log_file_name.c_str(), "a");
 }
 
-void UI::Start()
+void UI::Start(bool headless)
 {
+  // Headless: no curses at all; fields are never drawn and messages go to stderr.
+  UI::headless = headless;
+  if (headless)
+    return;
+
   initscr();
   cbreak();
   noecho();
@@ -61,6 +68,9 @@ void UI::Start()
 
 void UI::Reset()
 {
+  if (headless)
+    return;
+
   mtx.lock();
   wclear(stdscr);
   wrefresh(stdscr);
@@ -143,6 +153,9 @@ void UI::ScrollDown()
 
 void UI::Update(bool full)
 {
+  if (headless)
+    return;
+
   mtx.lock();
   curs_set(0);
   for (auto f: fields)
@@ -169,6 +182,14 @@ void UI::Update(bool full)
 
 int UI::End() {
   mtx.lock();
+  if (headless) {
+    if (logfile) {
+      fclose(logfile);
+      logfile = NULL;
+    }
+    mtx.unlock();
+    return OK;
+  }
   for (WINDOW **w: { &logp, &logboxw, &cmdw, &statusp, &mainw }) {
     if (*w) delwin(*w);
     *w = NULL;
@@ -208,10 +229,34 @@ static const char *current_minutes() {
   return time_buf;
 }
 
+static int log_headless(FILE *logfile, const char *prefix, const char *format, va_list argp)
+{
+  va_list argp2;
+  va_copy(argp2, argp);
+  fprintf(stderr, "%s", prefix);
+  int r = vfprintf(stderr, format, argp);
+  fprintf(stderr, "\n");
+  if (logfile) {
+    fprintf(logfile, "\n%s %s> ", current_day(), current_minutes());
+    vfprintf(logfile, format, argp2);
+    fflush(logfile);
+  }
+  va_end(argp2);
+  return r;
+}
+
 int UI::Log(const char *format, ...)
 {
   int r = 0;
-  if (logp) {
+  if (headless) {
+    mtx.lock();
+    va_list argp;
+    va_start(argp, format);
+    r = log_headless(logfile, "", format, argp);
+    va_end(argp);
+    mtx.unlock();
+  }
+  else if (logp) {
     mtx.lock();
     va_list argp;
     va_start(argp, format);
@@ -232,6 +277,15 @@ int UI::Log(const char *format, ...)
 
 void UI::Error(const char *format, ...)
 {
+  if (headless) {
+    const std::lock_guard<std::mutex> lock(mtx);
+    va_list argp;
+    va_start(argp, format);
+    log_headless(logfile, "ERROR: ", format, argp);
+    va_end(argp);
+    return;
+  }
+
   wclear(cmdw);
   wattron(cmdw, COLOR_PAIR(LOW_PAIR));
   va_list argp;
@@ -245,6 +299,15 @@ void UI::Error(const char *format, ...)
 
 void UI::Info(const char *format, ...)
 {
+  if (headless) {
+    const std::lock_guard<std::mutex> lock(mtx);
+    va_list argp;
+    va_start(argp, format);
+    log_headless(logfile, "> ", format, argp);
+    va_end(argp);
+    return;
+  }
+
   werase(cmdw);
   wattron(cmdw, COLOR_PAIR(HIGHLIGHT_PAIR));
   va_list argp;
@@ -273,6 +336,9 @@ int UI::GetKey()
 
 void UI::Layout()
 {
+  if (headless)
+    return;
+
   size_t h, w, widest = 0;
   size_t r = 0, c = 1;
   getmaxyx(statusp, h, w);
@@ -25,6 +25,7 @@ protected:
   size_t active_field_index;
   std::set<std::shared_ptr<DeviceBase>> devices;
   static FILE *logfile;
+  static bool headless;
 
 public:
   UI();
@@ -35,7 +36,8 @@ public:
   static WINDOW *mainw, *logp, *logboxw, *cmdw, *statusp;
   static uint64_t indicator_value, max_indicator_value;
 
-  static void Start();
+  static void Start(bool headless = false);
+  static bool Headless() { return headless; }
   static int Log(const char *format, ...);
   static int Log(const std::string &s) { return Log("%s", s.c_str()); }
   static void Error(const char *format, ...);
@@ -0,0 +1,152 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#include <signal.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "ui.h"
+#include "update_pool.h"
+
+UpdatePool::UpdatePool(size_t num_workers, std::function<void()> notify) :
+  jobs(0),
+  notify(notify),
+  overruns(0),
+  completed(0),
+  stopping(false)
+{
+  if (num_workers == 0)
+    num_workers = std::max(2u, std::thread::hardware_concurrency());
+
+  for (size_t i = 0; i < num_workers; i++)
+    workers.emplace_back(&UpdatePool::Worker, this);
+}
+
+UpdatePool::~UpdatePool()
+{
+  Stop();
+}
+
+bool UpdatePool::Submit(std::shared_ptr<DeviceBase> device, int tag, job_t &&job)
+{
+  if (!device)
+    return false;
+
+  {
+    const std::lock_guard<std::mutex> lock(mtx);
+    if (stopping)
+      return false;
+
+    std::string key = LaneKey(*device);
+    Lane &lane = lanes[key];
+    for (const Job &j : lane.pending)
+      if (j.device == device && j.tag == tag) {
+        overruns++;
+        return false;
+      }
+
+    if (!lane.running && lane.pending.empty())
+      ready.push_back(key);
+    lane.pending.push_back({device, tag, std::move(job)});
+    jobs++;
+  }
+
+  work_cv.notify_one();
+  return true;
+}
+
+void UpdatePool::Wait()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  idle_cv.wait(lock, [this]() { return jobs == 0; });
+}
+
+void UpdatePool::Stop()
+{
+  {
+    const std::lock_guard<std::mutex> lock(mtx);
+    if (stopping)
+      return;
+    stopping = true;
+  }
+
+  work_cv.notify_all();
+
+  for (auto &t : workers)
+    if (t.joinable())
+      t.join();
+}
+
+std::string UpdatePool::LaneKey(const DeviceBase &device)
+{
+  std::string bus = device.Bus();
+  if (!bus.empty())
+    return bus;
+
+  // Bus names never start with '@'.
+  char buf[32];
+  snprintf(buf, sizeof(buf), "@%p", (const void*)&device);
+  return buf;
+}
+
+size_t UpdatePool::InFlight() const
+{
+  const std::lock_guard<std::mutex> lock(mtx);
+  return jobs;
+}
+
+void UpdatePool::Worker()
+{
+  // Asynchronous signals (timers, SIGINT) are for the controller thread.
+  sigset_t all;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+  while (true) {
+    std::string key;
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      work_cv.wait(lock, [this]() { return stopping || !ready.empty(); });
+      if (ready.empty())
+        return;
+      key = std::move(ready.front());
+      ready.pop_front();
+      Lane &lane = lanes[key];
+      job = std::move(lane.pending.front());
+      lane.pending.pop_front();
+      lane.running = true;
+    }
+
+    try {
+      job.f(*job.device);
+    }
+    catch (std::exception &ex) {
+      UI::Log("Exception during threaded update: %s", ex.what());
+    }
+    catch (...) {
+      UI::Log("Unknown exception during threaded update");
+    }
+
+    {
+      const std::lock_guard<std::mutex> lock(mtx);
+      Lane &lane = lanes[key];
+      lane.running = false;
+      if (!lane.pending.empty())
+        ready.push_back(key);
+      else
+        lanes.erase(key);
+      jobs--;
+      completed++;
+    }
+    work_cv.notify_one();
+    idle_cv.notify_all();
+
+    if (notify)
+      notify();
+  }
+}
@@ -0,0 +1,71 @@
+// Copyright (c) Christoph M. Wintersteiger
+// Licensed under the MIT License.
+
+#ifndef _UPDATE_POOL_H_
+#define _UPDATE_POOL_H_
+
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "device.h"
+
+// A fixed set of long-lived worker threads that run device updates. Jobs for
+// devices on the same bus (or for the same device, if it has no shared bus)
+// run one after the other, in submission order; different buses run in
+// parallel. A job that is submitted while an identical one (same device and
+// tag) is still waiting is coalesced into it and counted as an overrun.
+// `notify` is called by the worker after each job.
+class UpdatePool {
+public:
+  typedef std::function<void(DeviceBase&)> job_t;
+
+  UpdatePool(size_t num_workers = 0, std::function<void()> notify = nullptr);
+  virtual ~UpdatePool();
+
+  bool Submit(std::shared_ptr<DeviceBase> device, int tag, job_t &&job);
+
+  void Wait();
+  void Stop();
+
+  size_t InFlight() const;
+  uint64_t Overruns() const { return overruns; }
+  uint64_t Completed() const { return completed; }
+  size_t Workers() const { return workers.size(); }
+
+protected:
+  struct Job {
+    std::shared_ptr<DeviceBase> device;
+    int tag;
+    job_t f;
+  };
+
+  struct Lane {
+    std::deque<Job> pending;
+    bool running = false;
+  };
+
+  mutable std::mutex mtx;
+  std::condition_variable work_cv, idle_cv;
+  std::map<std::string, Lane> lanes;
+  std::deque<std::string> ready;
+  size_t jobs;
+  std::vector<std::thread> workers;
+  std::function<void()> notify;
+  std::atomic<uint64_t> overruns, completed;
+  bool stopping;
+
+  static std::string LaneKey(const DeviceBase &device);
+
+  void Worker();
+};
+
+#endif // _UPDATE_POOL_H_